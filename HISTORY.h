@@ -7,8 +7,8 @@
  *
  */
 
-#define _VERSION     "0.0.26"
-#define VERSION_DATE "05.05.2020"
+#define _VERSION     "0.0.27"
+#define VERSION_DATE "19.10.2026"
 
 #ifdef GIT_REV
 #  define VERSION _VERSION "-GIT" GIT_REV
@@ -19,6 +19,33 @@
 /*
  * ------------------------------------
 
+2026-10-19: Version 0.0.27
+  - added: Optional JSON-RPC transport (LMS http port) with streaming JSON parser
+  - added: Fake LMS (make lmsfake) to record and replay sessions for offline tests
+  - added: Benchmarks (make bench) for protocol, parsing and imaging, JSON lines output
+  - added: Latency statistics of LMS requests, covers, imaging and OSD (SVDRP STAT/RSET)
+  - change: Logging via lock free queue and log thread, disabled levels aren't formatted
+  - change: LMS request line is sent with one writev, TCP no delay setup option
+  - change: Own allocation free URL (un)escaping instead of curl
+  - change: Status answer (CLI) is parsed while arriving, first playlist page drawn early
+  - change: Player state and playlist are published as immutable snapshots
+  - change: One shared LMS connection for control, OSD and menus, SVDRP INFO
+  - change: Player start waits for audio device release and LMS registration instead of fixed sleeps
+  - added: Optional persistent squeezelite (setup 'Keep player running'), switched by power on/off
+  - change: Squeezelite supervised by pidfd and poll, restart with backoff, log line counters (SVDRP STAT)
+  - added: Background watcher keeps LMS connection, state and covers warm, process wide cover/image cache
+  - added: Last state, playlist window and scaled covers persisted in the cache directory (state.bin)
+  - change: Menu items stored index addressable with one string arena instead of a cList
+  - change: Sub menus are loaded page by page in the background, OK doesn't block the OSD, Back cancels
+  - added: Cache of the library menu queries, cleared on LMS rescan, hit/miss counters (SVDRP STAT)
+  - added: Local library index (library.idx, mmap) for the menus, rebuilt in the background if the LMS lastscan changes
+  - added: Search menu, type-ahead by multi-tap number keys, trigram search of the library index, LMS search as fallback
+  - added: Jump by the first letter (number keys) in large library menus, loaded window by window
+  - added: Optional sorting of radios and favorites, library index ordered by the locale (collation keys)
+  - added: Radio cache with TTL, stale pages are served and refreshed in the background
+  - change: Playlist drawn into a taller draw port, only changed rows are drawn again
+  - added: Cache of rendered playlist and menu rows, hit ratio of the caches in the statistics
+
 2020-05-05: Version 0.0.26
   - bugfix: Fixed crash without seduatmo plugin (patch by Alexander Grothe)
 
@@ -0,0 +1,581 @@
+/*
+ * bench.c
+ *
+ * Benchmarks of the protocol, parsing and imaging hot paths,
+ * results are written as JSON lines (one object per benchmark)
+ *
+ * See the README file for copyright information
+ *
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include <string>
+#include <functional>
+
+#include <curl/curl.h>
+
+#include <vdr/thread.h>
+#include <vdr/osd.h>
+
+#include "lib/common.h"
+#include "lmccom.h"
+#include "lmctag.h"
+#include "lmcjson.h"
+#include "imgtools.h"
+#include "HISTORY.h"
+
+//***************************************************************************
+// Allocation Counter
+//  - malloc & co are replaced by wrappers around the glibc functions,
+//    operator new of libstdc++ ends up here too
+//***************************************************************************
+
+extern "C"
+{
+   void* __libc_malloc(size_t size);
+   void* __libc_calloc(size_t n, size_t size);
+   void* __libc_realloc(void* p, size_t size);
+   void __libc_free(void* p);
+}
+
+static int countAllocs = no;
+static uint64_t allocCount = 0;
+static uint64_t allocBytes = 0;
+
+extern "C" void* malloc(size_t size)
+{
+   if (countAllocs) { allocCount++; allocBytes += size; }
+   return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size)
+{
+   if (countAllocs) { allocCount++; allocBytes += n * size; }
+   return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* p, size_t size)
+{
+   if (countAllocs) { allocCount++; allocBytes += size; }
+   return __libc_realloc(p, size);
+}
+
+extern "C" void free(void* p)
+{
+   __libc_free(p);
+}
+
+//***************************************************************************
+// Options
+//***************************************************************************
+
+const char* filter = 0;
+const char* dumpFile = 0;
+const char* imageFile = 0;
+const char* lmsHost = 0;
+unsigned short lmsPort = 9090;
+int minTime = 500;              // [ms] per benchmark
+int trackCount = 500;
+
+//***************************************************************************
+// Usage
+//***************************************************************************
+
+void showUsage(const char* name)
+{
+   printf("Usage: %s [-n <filter>] [-f <status-dump>] [-i <image>] [-t <tracks>] [-m <ms>] [-l <host:port>]\n", name);
+   printf("    -n <filter>       run only benchmarks containing <filter> in their name\n");
+   printf("    -f <status-dump>  CLI answer of 'status' (like recorded by lmsfake)\n");
+   printf("    -i <image>        image for the createImage benchmark\n");
+   printf("    -t <tracks>       tracks of the synthetic status dump (default 500)\n");
+   printf("    -m <ms>           minimal run time of each benchmark (default 500)\n");
+   printf("    -l <host:port>    CLI of a (fake) LMS for the request round trip benchmarks\n");
+   printf("\n");
+   printf("  Prints one JSON object per line:\n");
+   printf("    name, version, iterations, ns_per_op, allocs_per_op, bytes_per_op, throughput, unit\n");
+}
+
+//***************************************************************************
+// Run
+//  - repeat op() until minTime is reached, work is the amount of
+//    'unit' processed by one call (bytes, pixels, tracks, ...)
+//***************************************************************************
+
+uint64_t nsNow()
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void run(const char* name, double work, const char* unit, std::function<void()> op)
+{
+   uint64_t iterations = 1;
+   uint64_t elapsed = 0;
+
+   if (filter && !strstr(name, filter))
+      return;
+
+   op();    // warm up
+
+   while (true)
+   {
+      allocCount = allocBytes = 0;
+      countAllocs = yes;
+
+      uint64_t start = nsNow();
+
+      for (uint64_t i = 0; i < iterations; i++)
+         op();
+
+      elapsed = nsNow() - start;
+      countAllocs = no;
+
+      if (elapsed >= minTime * 1000000ULL)
+         break;
+
+      iterations *= elapsed < minTime * 100000ULL ? 10 : 2;
+   }
+
+   double nsPerOp = elapsed / (double)iterations;
+
+   printf("{\"name\":\"%s\",\"version\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.1f,"
+          "\"allocs_per_op\":%.2f,\"bytes_per_op\":%.1f,\"throughput\":%.3f,\"unit\":\"%s\"}\n",
+          name, VERSION, (unsigned long long)iterations, nsPerOp,
+          allocCount / (double)iterations, allocBytes / (double)iterations,
+          work * 1000000000.0 / nsPerOp, unit);
+
+   fflush(stdout);
+}
+
+//***************************************************************************
+// Status Dump
+//***************************************************************************
+
+std::string escaped(const std::string& str)
+{
+   char* p = curl_easy_escape(0, str.c_str(), str.length());
+   std::string res = p;
+
+   curl_free(p);
+
+   return res;
+}
+
+// synthetic answer, same layout as lmsfake delivers
+
+void createDumps(int count, std::string& cli, std::string& json)
+{
+   const char* player[][2] =
+   {
+      { "player_name", "VDR-squeeze" }, { "player_connected", "1" }, { "power", "1" },
+      { "mode", "play" }, { "time", "42" }, { "mixer volume", "50" }, { "playlist repeat", "0" },
+      { "playlist shuffle", "0" }, { "playlist_cur_index", "3" }, { 0, 0 }
+   };
+
+   cli = "";
+   json = "{\"id\":1,\"method\":\"slim.request\",\"result\":{";
+
+   for (int i = 0; player[i][0]; i++)
+   {
+      cli += escaped(std::string(player[i][0]) + ":" + player[i][1]) + " ";
+      json += "\"" + std::string(player[i][0]) + "\":\"" + player[i][1] + "\",";
+   }
+
+   json += "\"playlist_loop\":[";
+
+   for (int i = 0; i < count; i++)
+   {
+      std::string fields[][2] =
+      {
+         { "playlist index", std::to_string(i) },
+         { "id", std::to_string(10000+i) },
+         { "title", "Track " + std::to_string(i) + " - Ein längerer Titel" },
+         { "artist", "Artist " + std::to_string(i % 100) },
+         { "album", "Album " + std::to_string(i / 10) },
+         { "genre", "Rock" },
+         { "duration", std::to_string(120 + i % 300) },
+         { "year", "1999" },
+         { "bitrate", "320kbps CBR" },
+         { "type", "mp3" },
+         { "", "" }
+      };
+
+      json += i ? ",{" : "{";
+
+      for (int f = 0; !fields[f][0].empty(); f++)
+      {
+         cli += escaped(fields[f][0] + ":" + fields[f][1]) + " ";
+         json += (f ? ",\"" : "\"") + fields[f][0] + "\":\"" + fields[f][1] + "\"";
+      }
+
+      json += "}";
+   }
+
+   json += "]}}";
+}
+
+// load a recorded answer, the echo of the request is removed
+
+int loadDump(const char* path, std::string& cli)
+{
+   FILE* fp;
+   char* line = 0;
+   size_t size = 0;
+
+   if (!(fp = fopen(path, "r")))
+   {
+      fprintf(stderr, "Can't open '%s', %m\n", path);
+      return fail;
+   }
+
+   cli = "";
+
+   while (getline(&line, &size, fp) > 0)
+   {
+      char* p = rTrim(line);
+
+      if (strncmp(p, "< ", 2) == 0)
+         p += 2;
+
+      if (*p == '>' || *p == '@' || !strstr(p, " status "))
+         continue;
+
+      // skip '<player> status <from> <count> [tags]'
+
+      p = strstr(p, " status ") + 8;
+
+      while (*p && (isdigit(*p) || strncmp(p, "tags%3A", 7) == 0))
+      {
+         p = strchrnul(p, ' ');
+
+         if (*p)
+            p++;
+      }
+
+      cli = p;
+      break;
+   }
+
+   free(line);
+   fclose(fp);
+
+   return cli.empty() ? fail : success;
+}
+
+//***************************************************************************
+// Benchmarks
+//***************************************************************************
+
+void benchProtocol()
+{
+   std::string cli, json;
+   LmcCom lmc("00:00:00:00:00:00");
+   LmcCom lmcJson("00:00:00:00:00:00");
+   const int maxValue = 10000;
+   char value[maxValue+TB];
+
+   createDumps(trackCount, cli, json);
+
+   if (dumpFile && loadDump(dumpFile, cli) != success)
+   {
+      fprintf(stderr, "No answer of 'status' found in '%s'\n", dumpFile);
+      return;
+   }
+
+   lmcJson.setTransport(LmcCom::ttJsonRpc);
+
+   run("lmctag.getNext.cli", cli.length() / 1048576.0, "MB/s", [&]()
+   {
+      LmcTag lt(&lmc);
+      int tag;
+
+      lt.set(cli.c_str());
+      while (lt.getNext(tag, value, maxValue) != LmcTag::wrnEndOfPacket) ;
+   });
+
+   run("lmctag.getNext.json", json.length() / 1048576.0, "MB/s", [&]()
+   {
+      LmcJsonTag lt(&lmcJson);
+      int tag;
+
+      lt.set(json.c_str());
+      while (lt.getNext(tag, value, maxValue) != LmcTag::wrnEndOfPacket) ;
+   });
+
+   lmc.parseStatus(cli.c_str());
+
+   run("lmccom.parseStatus.cli", lmc.getSnapshot()->getTrackCount(), "tracks/s", [&]()
+   {
+      lmc.parseStatus(cli.c_str());
+   });
+
+   run("lmccom.parseStatus.json", trackCount, "tracks/s", [&]()
+   {
+      lmcJson.parseStatus(json.c_str());
+   });
+
+   const char* token = "title%3ATrack%2042%20-%20Ein%20l%C3%A4ngerer%20Titel%20%26%20mehr";
+   char buf[200+TB];
+
+   run("lmccom.unescape", strlen(token) / 1048576.0, "MB/s", [&]()
+   {
+      strcpy(buf, token);
+      lmc.unescape(buf);
+   });
+}
+
+//***************************************************************************
+// Round Trip
+//  - request / response against a running LMS (or lmsfake), with and
+//    without TCP_NODELAY and with the former framing (one write per part)
+//***************************************************************************
+
+void benchRoundtrip()
+{
+   const char* mac = "00:00:00:00:00:00";
+   int value;
+
+   if (!lmsHost)
+      return;
+
+   for (int noDelay = yes; noDelay >= no; noDelay--)
+   {
+      LmcCom lmc(mac);
+
+      lmc.setNoDelay(noDelay);
+
+      if (lmc.open(lmsHost, lmsPort) != success)
+      {
+         fprintf(stderr, "Connecting LMS at '%s:%d' failed\n", lmsHost, lmsPort);
+         return;
+      }
+
+      run(noDelay ? "lmccom.roundtrip.queryInt" : "lmccom.roundtrip.queryInt.nagle", 1, "requests/s", [&]()
+      {
+         lmc.queryInt("mixer volume", value);
+      });
+   }
+
+   TcpChannel channel;
+   char* escId = curl_easy_escape(0, mac, 0);
+
+   if (channel.open(lmsPort, lmsHost) != success)
+      return;
+
+   run("tcpchannel.roundtrip.split.nagle", 1, "requests/s", [&]()
+   {
+      channel.write(escId);
+      channel.write(" ");
+      channel.write("mixer volume");
+      channel.write(" ?\n");
+
+      if (channel.look(30000) == success)
+         free(channel.readln());
+   });
+
+   curl_free(escId);
+}
+
+void benchImaging()
+{
+   const int sizes[][4] =
+   {
+      {  500,  500, 280, 280 },       // cover in the OSD
+      { 1000, 1000, 420, 420 },       // large cover
+      { 1920, 1080, 640, 360 },       // background
+      {    0 }
+   };
+
+   for (int i = 0; sizes[i][0]; i++)
+   {
+      char name[100];
+      const int sw = sizes[i][0], sh = sizes[i][1], dw = sizes[i][2], dh = sizes[i][3];
+      unsigned char* src = (unsigned char*)malloc(sw * sh * 4);
+      unsigned* dst = (unsigned*)malloc(dw * dh * sizeof(unsigned));
+      ImageScaler scaler;
+
+      for (int p = 0; p < sw * sh * 4; p++)
+         src[p] = p * 7;
+
+      sprintf(name, "imagescaler.%dx%d-%dx%d", sw, sh, dw, dh);
+
+      run(name, sw * sh / 1000000.0, "Mpixel/s", [&]()
+      {
+         const unsigned char* s = src;
+
+         scaler.SetImageParameters(dst, dw, dw, dh, sw, sh);
+
+         for (const unsigned char* end = src + sw * sh * 4; s < end; s += 4)
+            scaler.PutSourcePixel(s[0], s[1], s[2], s[3]);
+      });
+
+      free(src);
+      free(dst);
+   }
+
+   cImageMagickWrapper imgLoader;
+
+   if (imageFile)
+   {
+      if (imgLoader.loadImage(imageFile) != success)
+         return;
+   }
+   else
+   {
+      // synthetic cover
+
+      Image image(Geometry(500, 500), Color("navy"));
+      Blob blob;
+
+      image.magick("JPEG");
+      image.write(&blob);
+      imgLoader.loadImage((const char*)blob.data(), blob.length());
+   }
+
+   run("imagemagick.createImage.280x280", 280 * 280 / 1000000.0, "Mpixel/s", [&]()
+   {
+      delete imgLoader.createImage(280, 280, true);
+   });
+}
+
+//***************************************************************************
+// Main
+//***************************************************************************
+
+int main(int argc, char** argv)
+{
+   loglevel = eloOff;
+
+   for (int i = 1; argv[i]; i++)
+   {
+      if (argv[i][0] != '-' || strlen(argv[i]) != 2 || !argv[i+1])
+      {
+         showUsage(argv[0]);
+         return 1;
+      }
+
+      switch (argv[i][1])
+      {
+         case 'n': filter = argv[++i];             break;
+         case 'f': dumpFile = argv[++i];           break;
+         case 'i': imageFile = argv[++i];          break;
+         case 't': trackCount = atoi(argv[++i]);   break;
+         case 'm': minTime = atoi(argv[++i]);      break;
+
+         case 'l':
+         {
+            char* p;
+
+            lmsHost = argv[++i];
+
+            if ((p = strchr(argv[i], ':')))
+            {
+               *p = 0;
+               lmsPort = atoi(p+1);
+            }
+
+            break;
+         }
+
+         default:
+         {
+            showUsage(argv[0]);
+            return 1;
+         }
+      }
+   }
+
+   benchProtocol();
+   benchRoundtrip();
+   benchImaging();
+
+   return 0;
+}
+
+//***************************************************************************
+// VDR Core
+//  - the benchmark isn't linked against vdr, provide the few
+//    symbols of the core used by the measured code
+//***************************************************************************
+
+cMutex::cMutex()
+{
+   pthread_mutexattr_t attr;
+
+   locked = 0;
+   pthread_mutexattr_init(&attr);
+   pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+   pthread_mutex_init(&mutex, &attr);
+}
+
+cMutex::~cMutex()                 { pthread_mutex_destroy(&mutex); }
+void cMutex::Lock()               { pthread_mutex_lock(&mutex); locked++; }
+void cMutex::Unlock()             { locked--; pthread_mutex_unlock(&mutex); }
+
+cMutexLock::cMutexLock(cMutex* Mutex)
+{
+   mutex = 0;
+   locked = false;
+   Lock(Mutex);
+}
+
+cMutexLock::~cMutexLock()
+{
+   if (mutex && locked)
+      mutex->Unlock();
+}
+
+bool cMutexLock::Lock(cMutex* Mutex)
+{
+   if (Mutex && !mutex)
+   {
+      mutex = Mutex;
+      Mutex->Lock();
+      locked = true;
+      return true;
+   }
+
+   return false;
+}
+
+uint64_t cTimeMs::Now()
+{
+   return nsNow() / 1000000;
+}
+
+cImage::cImage()
+{
+   data = 0;
+}
+
+cImage::cImage(const cImage& Image)
+{
+   size = Image.Size();
+   data = 0;
+
+   if (Image.Data())
+   {
+      data = (tColor*)malloc(size.Width() * size.Height() * sizeof(tColor));
+      memcpy(data, Image.Data(), size.Width() * size.Height() * sizeof(tColor));
+   }
+}
+
+cImage::cImage(const cSize& Size, const tColor* Data)
+{
+   size = Size;
+   data = (tColor*)malloc(size.Width() * size.Height() * sizeof(tColor));
+
+   if (Data)
+      memcpy(data, Data, size.Width() * size.Height() * sizeof(tColor));
+}
+
+cImage::~cImage()
+{
+   free(data);
+}
@@ -9,6 +9,7 @@
 
 #include "lib/common.h"
 #include "config.h"
+#include "lmccom.h"
 
 //***************************************************************************
 // Config
@@ -20,11 +21,17 @@ cSqueezeConfig::cSqueezeConfig()
    lmcHost = strdup("localhost");
    lmcPort = 9090;
    lmcHttpPort = 9000;
+   jsonRpc = no;
+   tcpNoDelay = yes;
 
    squeezeCmd = strdup("/usr/local/bin/squeezelite");
    playerName = strdup("VDR-squeeze");
    audioDevice = strdup("");
    alsaOptions = strdup("");
+   persistentPlayer = no;
+   libraryIndex = yes;
+   sortMenus = no;
+   radioCacheTtl = 30;
 
    shadeTime = 0;
    shadeLevel = 40;  // in %
@@ -65,12 +72,18 @@ void cMenuSqueezeSetup::Setup()
    Add(new cMenuEditStrItem(tr("LMS Host"), lmcHost, sizeof(lmcHost), tr(FileNameChars)));
    Add(new cMenuEditIntItem(tr("LMS Port"), &cfg.lmcPort, 1, 99999));
    Add(new cMenuEditIntItem(tr("LMS/Http Port"), &cfg.lmcHttpPort, 1, 99999));
+   Add(new cMenuEditBoolItem(tr("Use JSON-RPC"), &cfg.jsonRpc));
+   Add(new cMenuEditBoolItem(tr("TCP no delay"), &cfg.tcpNoDelay));
 
    Add(new cMenuEditStrItem(tr("Player Name"), playerName, sizeof(playerName), tr(FileNameChars)));
    Add(new cMenuEditStrItem(tr("Player MAC"), mac, sizeof(mac), tr(FileNameChars)));
    Add(new cMenuEditStrItem(tr("Squeezelite Path"), squeezeCmd, sizeof(squeezeCmd), tr(FileNameChars)));
    Add(new cMenuEditStrItem(tr("Audio Device"), audioDevice, sizeof(audioDevice), tr(FileNameChars)));
    Add(new cMenuEditStrItem(tr("Alsa Options"), alsaOptions, sizeof(alsaOptions), tr(FileNameChars)));
+   Add(new cMenuEditBoolItem(tr("Keep player running"), &cfg.persistentPlayer));
+   Add(new cMenuEditBoolItem(tr("Local library index"), &cfg.libraryIndex));
+   Add(new cMenuEditBoolItem(tr("Sort radios and favorites"), &cfg.sortMenus));
+   Add(new cMenuEditIntItem(tr("Radio cache TTL [min]"), &cfg.radioCacheTtl, 0, 1440));
 
    Add(new cMenuEditIntItem(tr("Shade Time [s]"), &cfg.shadeTime, 0, 3600));
    Add(new cMenuEditIntItem(tr("Shade Level [%]"), &cfg.shadeLevel, 0, 100));
@@ -120,6 +133,8 @@ void cMenuSqueezeSetup::Store(void)
    SetupStore("lmcHost", cfg.lmcHost);
    SetupStore("lmcPort", cfg.lmcPort);
    SetupStore("lmcHttpPort", cfg.lmcHttpPort);
+   SetupStore("jsonRpc", cfg.jsonRpc);
+   SetupStore("tcpNoDelay", cfg.tcpNoDelay);
    SetupStore("rounded", cfg.rounded);
    SetupStore("shadeTime", cfg.shadeTime);
    SetupStore("shadeLevel", cfg.shadeLevel);
@@ -128,4 +143,10 @@ void cMenuSqueezeSetup::Store(void)
    SetupStore("playerMac", cfg.mac);
    SetupStore("audioDevice", cfg.audioDevice);
    SetupStore("alsaOptions", cfg.alsaOptions);
+   SetupStore("persistentPlayer", cfg.persistentPlayer);
+   SetupStore("libraryIndex", cfg.libraryIndex);
+   SetupStore("sortMenus", cfg.sortMenus);
+   SetupStore("radioCacheTtl", cfg.radioCacheTtl);
+
+   RadioCache::setTtl(cfg.radioCacheTtl * 60);
 }
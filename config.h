@@ -23,12 +23,18 @@ class cSqueezeConfig
       char* lmcHost;
       int lmcPort;
       int lmcHttpPort;
+      int jsonRpc;
+      int tcpNoDelay;
 
       char* squeezeCmd;
       char* playerName;
       char* mac;
       char* audioDevice;
       char* alsaOptions;
+      int persistentPlayer;
+      int libraryIndex;
+      int sortMenus;
+      int radioCacheTtl;           // [min]
 
       int logLevel;
       int shadeTime;
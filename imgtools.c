@@ -1,9 +1,16 @@
 
 #include "imgtools.h"
+#include "lib/stats.h"
 
 #include <cstdlib>
 #include <cmath>
 
+cImageMagickWrapper::Images cImageMagickWrapper::cache;
+std::unordered_map<std::string,cImageMagickWrapper::Images::iterator> cImageMagickWrapper::cacheIndex;
+size_t cImageMagickWrapper::cacheSize = 0;
+std::string cImageMagickWrapper::geometry;
+cMutex cImageMagickWrapper::cacheMutex;
+
 cImageMagickWrapper::cImageMagickWrapper() 
 {
    InitializeMagick(0);
@@ -22,6 +29,8 @@ cImage* cImageMagickWrapper::createImageFromFile(const char* path, int width, in
 
 cImage* cImageMagickWrapper::createImage(int width, int height, bool preserveAspect) 
 {
+   static LatencyStat* stat = Statistics::get("image.scale");
+   LatencyProbe probe(stat);
    int w, h;
    w = buffer.columns();
    h = buffer.rows();
@@ -92,6 +101,8 @@ cImage cImageMagickWrapper::createImageCopy()
 
 int cImageMagickWrapper::loadImage(const char* data, int size) 
 {
+   static LatencyStat* stat = Statistics::get("image.decode");
+   LatencyProbe probe(stat);
    Blob blob(data, size); 
 
    buffer.read(blob);
@@ -104,6 +115,9 @@ int cImageMagickWrapper::loadImage(const char* fullpath)
    if (!fullpath || (strlen(fullpath) < 5))
       return fail;
 
+   static LatencyStat* stat = Statistics::get("image.decode");
+   LatencyProbe probe(stat);
+
    try 
    {
       buffer.read(fullpath);
@@ -180,6 +194,156 @@ void cImageMagickWrapper::createBackgroundReverse(tColor back, tColor blend, int
    createGradient(back, blend, width, height, 1.3, 0.7);
 }
 
+//***************************************************************************
+// Cover Cache
+//***************************************************************************
+
+cImage* cImageMagickWrapper::fromCache(const std::string& hash)
+{
+   cMutexLock lock(&cacheMutex);
+   auto it = cacheIndex.find(hash);
+
+   if (it == cacheIndex.end())
+      return 0;
+
+   cache.splice(cache.begin(), cache, it->second);      // latest first
+
+   return &it->second->second;
+}
+
+cImage* cImageMagickWrapper::addCache(const std::string& hash, const cImage* image)
+{
+   cMutexLock lock(&cacheMutex);
+   size_t bytes = (size_t)image->Width() * image->Height() * sizeof(tColor);
+   auto it = cacheIndex.find(hash);
+
+   if (it != cacheIndex.end())
+   {
+      cacheSize -= (size_t)it->second->second.Width() * it->second->second.Height() * sizeof(tColor);
+      cache.erase(it->second);
+      cacheIndex.erase(it);
+   }
+
+   cache.push_front(std::make_pair(hash, *image));
+   cacheIndex[hash] = cache.begin();
+   cacheSize += bytes;
+
+   while (cacheSize > maxCacheSize && cache.size() > 1)     // never the one just added
+   {
+      const cImage& last = cache.back().second;
+
+      cacheSize -= (size_t)last.Width() * last.Height() * sizeof(tColor);
+      cacheIndex.erase(cache.back().first);
+      cache.pop_back();
+   }
+
+   return &cache.front().second;
+}
+
+void cImageMagickWrapper::clearCache()
+{
+   cMutexLock lock(&cacheMutex);
+
+   cache.clear();
+   cacheIndex.clear();
+   cacheSize = 0;
+}
+
+//***************************************************************************
+// Set Geometry
+//  - the covers are scaled for the OSD size, drop them if it changes,
+//    covers restored by the state cache before the first OSD are
+//    assumed to match
+//***************************************************************************
+
+void cImageMagickWrapper::setGeometry(const std::string& aGeometry)
+{
+   cMutexLock lock(&cacheMutex);
+
+   if (aGeometry == geometry)
+      return;
+
+   if (!geometry.empty())
+   {
+      tell(eloDetail, "OSD geometry changed, dropping %zu cached covers", cache.size());
+      clearCache();
+   }
+
+   geometry = aGeometry;
+}
+
+//***************************************************************************
+// Row Cache
+//***************************************************************************
+
+cRowCache::Rows cRowCache::rows;
+std::unordered_map<std::string,cRowCache::Rows::iterator> cRowCache::index;
+size_t cRowCache::size = 0;
+std::string cRowCache::layout;
+
+const cImage* cRowCache::get(const std::string& key)
+{
+   static EventCounter* hits = Statistics::getCounter("osd.rowCacheHits");
+   static EventCounter* misses = Statistics::getCounter("osd.rowCacheMisses");
+   auto it = index.find(key);
+
+   if (it == index.end())
+   {
+      misses->add();
+      return 0;
+   }
+
+   hits->add();
+   rows.splice(rows.begin(), rows, it->second);      // latest first
+
+   return &it->second->second;
+}
+
+void cRowCache::put(const std::string& key, const cImage& image)
+{
+   size_t bytes = (size_t)image.Width() * image.Height() * sizeof(tColor);
+   auto it = index.find(key);
+
+   if (it != index.end())
+   {
+      size -= (size_t)it->second->second.Width() * it->second->second.Height() * sizeof(tColor);
+      rows.erase(it->second);
+      index.erase(it);
+   }
+
+   if (bytes > maxSize)
+      return;
+
+   rows.push_front(std::make_pair(key, image));
+   index[key] = rows.begin();
+   size += bytes;
+
+   while (size > maxSize)
+   {
+      const cImage& last = rows.back().second;
+
+      size -= (size_t)last.Width() * last.Height() * sizeof(tColor);
+      index.erase(rows.back().first);
+      rows.pop_back();
+   }
+}
+
+void cRowCache::setLayout(const std::string& aLayout)
+{
+   if (aLayout == layout)
+      return;
+
+   clear();
+   layout = aLayout;
+}
+
+void cRowCache::clear()
+{
+   rows.clear();
+   index.clear();
+   size = 0;
+}
+
 //***************************************************************************
 // Scaler
 //***************************************************************************
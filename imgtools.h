@@ -3,9 +3,12 @@
 
 #include <Magick++.h>
 
-#include <map>
+#include <list>
+#include <string>
+#include <unordered_map>
 
 #include <vdr/osd.h>
+#include <vdr/thread.h>
 #include "lib/common.h"
 
 using namespace Magick;
@@ -31,26 +34,69 @@ class cImageMagickWrapper
       void createBackground(tColor back, tColor blend, int width, int height, bool mirror = false);
       void createBackgroundReverse(tColor back, tColor blend, int width, int height);
 
-      cImage* fromCache(std::string hash)
+      // the cache is only changed by the OSD thread, other threads
+      // reading it (state cache) hold the cache mutex, a returned image
+      // is valid until the next addCache() or clearCache()
+
+      enum Misc
       {
-         if (cache.find(hash) == cache.end())
-            return 0;
+         maxCacheSize = 48 * 1024 * 1024     // [byte] of all covers, least recently used dropped first
+      };
 
-         return &cache[hash];
-      }
+      static cImage* fromCache(const std::string& hash);
+      static cImage* addCache(const std::string& hash, const cImage* image);
+      static void clearCache();
+      static void setGeometry(const std::string& aGeometry);
 
-      void addCache(std::string hash, cImage* image)   { cache[hash] = *image; }
-      void clearCache()                                { cache.clear(); }
+      static cMutex* getCacheMutex()  { return &cacheMutex; }
 
    protected:
 
       Color argb2Color(tColor col);
       void createGradient(tColor back, tColor blend, int width, int height, double wfactor, double hfactor);
 
-      std::map<std::string,cImage> cache;
+      typedef std::list<std::pair<std::string,cImage>> Images;
+
+      static Images cache;                 // process wide, survives the OSD sessions, latest first
+      static std::unordered_map<std::string,Images::iterator> cacheIndex;
+      static size_t cacheSize;
+      static std::string geometry;         // the cached covers are scaled for
+      static cMutex cacheMutex;
       Image buffer;
 };
 
+//***************************************************************************
+// Row Cache
+//  - rendered rows (text, cover, symbols) of the playlist and the menu by
+//    a key of content, width and highlight, a redraw is a copy of the image
+//  - process wide like the cover cache but only used by the OSD thread,
+//    cleared if the layout (fonts, row size) differs from the cached one
+//***************************************************************************
+
+class cRowCache
+{
+   public:
+
+      enum Misc
+      {
+         maxSize = 32 * 1024 * 1024     // [byte] of all rows, oldest dropped first
+      };
+
+      static const cImage* get(const std::string& key);
+      static void put(const std::string& key, const cImage& image);
+      static void setLayout(const std::string& aLayout);
+      static void clear();
+
+   private:
+
+      typedef std::list<std::pair<std::string,cImage>> Rows;
+
+      static Rows rows;                 // latest first
+      static std::unordered_map<std::string,Rows::iterator> index;
+      static size_t size;
+      static std::string layout;
+};
+
 //***************************************************************************
 // this class scales images consisting of 4 components (RGBA)
 // to an arbitrary size using a 4-tap filter
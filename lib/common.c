@@ -18,72 +18,319 @@
 #include <unistd.h>
 #include <zlib.h>
 
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
 //#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 #ifdef VDR_PLUGIN
-# include <vdr/thread.h>
 # include <vdr/tools.h>
 #endif
 
 #include "common.h"
 
-#ifdef VDR_PLUGIN
-  cMutex logMutex;
-#endif
-
 int loglevel = 1;
 int logstdout = no;
 int logstamp = no;
 
 //***************************************************************************
-// Debug
+// Log Queue
+//  - bounded lock free queue, many producers (the callers of tell) and
+//    one consumer (serialized by logMutex), each slot carries a sequence
+//    telling whether it's free for the producer or filled for the consumer
 //***************************************************************************
 
-void tell(int eloquence, const char* format, ...)
+class LogQueue
 {
-   if (loglevel < eloquence)
-      return ;
+   public:
 
-   const int sizeBuffer = 100000;
-   char t[sizeBuffer+100]; *t = 0;
-   va_list ap;
+      enum Size
+      {
+         sizeQueue = 8192      // power of two
+      };
 
-#ifdef VDR_PLUGIN
-   cMutexLock lock(&logMutex);
+      LogQueue()
+      {
+         for (unsigned int i = 0; i < sizeQueue; i++)
+            slots[i].seq = i;
+
+         head = 0;
+         tail = 0;
+      }
+
+      int push(char* text)
+      {
+         unsigned int pos = head.load(std::memory_order_relaxed);
+
+         while (true)
+         {
+            Slot* slot = &slots[pos & (sizeQueue-1)];
+            int dif = (int)(slot->seq.load(std::memory_order_acquire) - pos);
+
+            if (dif < 0)
+               return fail;                         // full
+
+            if (dif > 0)
+               pos = head.load(std::memory_order_relaxed);
+            else if (head.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+            {
+               slot->text = text;
+               slot->seq.store(pos+1, std::memory_order_release);
+               return success;
+            }
+         }
+      }
+
+      char* pop()
+      {
+         Slot* slot = &slots[tail & (sizeQueue-1)];
+         char* text;
+
+         if (slot->seq.load(std::memory_order_acquire) != tail+1)
+            return 0;                               // empty
+
+         text = slot->text;
+         slot->seq.store(tail + sizeQueue, std::memory_order_release);
+         tail++;
+
+         return text;
+      }
+
+   private:
+
+      struct Slot
+      {
+         std::atomic<unsigned int> seq;
+         char* text;
+      };
+
+      Slot slots[sizeQueue];
+      std::atomic<unsigned int> head;
+      unsigned int tail;
+};
+
+static LogQueue logQueue;
+static std::mutex logMutex;
+static std::mutex logWaitMutex;
+static std::condition_variable logCondition;
+static std::thread* logThread = 0;
+static std::atomic<int> logThreadActive(no);
+static std::atomic<unsigned int> logDropped(0);
+static int logForked = no;
+
+//***************************************************************************
+// Write Log Message
+//***************************************************************************
+
+static void writeMessage(const char* t)
+{
+   if (logstdout)
+      printf("%s\n", t);
+   else
+      syslog(LOG_ERR, "%s", t);
+}
+
+//***************************************************************************
+// Flush Log Queue
+//  - logMutex has to be locked by the caller
+//***************************************************************************
+
+static void flushLogQueue()
+{
+   char* t;
+   unsigned int dropped;
+
+   while ((t = logQueue.pop()))
+   {
+      writeMessage(t);
+      free(t);
+   }
+
+   if ((dropped = logDropped.exchange(0)))
+   {
+      char buf[100+TB];
+
+#ifdef PLUGIN_NAME_I18N
+      snprintf(buf, 100, "%s: Warning: Log queue full, %u messages dropped", PLUGIN_NAME_I18N, dropped);
+#else
+      snprintf(buf, 100, "Warning: Log queue full, %u messages dropped", dropped);
 #endif
 
-   va_start(ap, format);
+      writeMessage(buf);
+   }
+}
+
+//***************************************************************************
+// Log Thread
+//***************************************************************************
+
+static void logLoop()
+{
+   while (logThreadActive)
+   {
+      {
+         std::unique_lock<std::mutex> lock(logWaitMutex);
+         logCondition.wait_for(lock, std::chrono::milliseconds(100));
+      }
+
+      std::lock_guard<std::mutex> lock(logMutex);
+      flushLogQueue();
+   }
+}
+
+int startLogThread()
+{
+   if (logThread)
+      return done;
+
+   logThreadActive = yes;
+   logThread = new std::thread(logLoop);
+
+   return success;
+}
+
+void stopLogThread()
+{
+   if (!logThread)
+      return;
+
+   logThreadActive = no;
+   logCondition.notify_one();
+   logThread->join();
+
+   delete logThread;
+   logThread = 0;
+
+   std::lock_guard<std::mutex> lock(logMutex);
+   flushLogQueue();
+}
+
+//***************************************************************************
+// Log After Fork
+//  - to be called by the child of a fork() before it logs, the log thread
+//    isn't copied into it
+//***************************************************************************
+
+void logAfterFork()
+{
+   logThreadActive = no;
+   logForked = yes;
+}
+
+//***************************************************************************
+// Debug
+//***************************************************************************
+
+void tellMessage(int eloquence, const char* format, ...)
+{
+   const int sizeBuffer = 1000;
+   const int sizeMax = 100000;
+   int errnoOrg = errno;          // keep it for %m
+   char buf[sizeBuffer+TB];
+   char* t = buf;
+   int len = 0;
+   int size;
+   va_list ap;
+
+   // stamp and prefix
+
+   if (logstdout && logstamp)
+   {
+      timeval tp;
+      tm* tm;
+
+      gettimeofday(&tp, 0);
+      tm = localtime(&tp.tv_sec);
+
+      len += sprintf(buf, "%2.2d:%2.2d:%2.2d,%3.3ld ",
+                     tm->tm_hour, tm->tm_min, tm->tm_sec,
+                     tp.tv_usec / 1000);
+   }
 
 #ifdef PLUGIN_NAME_I18N
-   snprintf(t, sizeBuffer, "%s: ", PLUGIN_NAME_I18N);
+   len += snprintf(buf+len, sizeBuffer-len, "%s: ", PLUGIN_NAME_I18N);
 #endif
 
-   vsnprintf(t+strlen(t), sizeBuffer-strlen(t), format, ap);
-   
-   if (logstdout)
+   errno = errnoOrg;
+   va_start(ap, format);
+   size = vsnprintf(buf+len, sizeBuffer-len, format, ap);
+   va_end(ap);
+
+   // too long for the stack buffer, format again on the heap
+
+   if (size >= sizeBuffer-len)
+   {
+      if (size > sizeMax)
+         size = sizeMax;
+
+      t = (char*)malloc(len+size+TB);
+      memcpy(t, buf, len);
+
+      errno = errnoOrg;
+      va_start(ap, format);
+      vsnprintf(t+len, size+TB, format, ap);
+      va_end(ap);
+   }
+
+   // in a forked child the mutex may be copied locked and the queue
+   // isn't drained by anyone, write it directly
+
+   if (logForked)
+   {
+      writeMessage(t);
+
+      if (t != buf)
+         free(t);
+
+      errno = errnoOrg;
+      return ;
+   }
+
+   // without log thread (tools, plugin not started) write it directly
+
+   if (!logThreadActive)
    {
-      char buf[50+TB];
-      *buf = 0;
+      std::lock_guard<std::mutex> lock(logMutex);
+
+      flushLogQueue();
+      writeMessage(t);
+
+      if (t != buf)
+         free(t);
 
-      if (logstamp)
+      errno = errnoOrg;
+      return ;
+   }
+
+   if (t == buf)
+      t = strdup(buf);
+
+   // queue full, the errors (eloAlways) are written in place after the
+   // pending ones, only the detail and debug messages are dropped
+
+   if (logQueue.push(t) != success)
+   {
+      if (eloquence <= eloAlways)
       {
-         timeval tp;
-         tm* tm;
-         
-         gettimeofday(&tp, 0);
-         tm = localtime(&tp.tv_sec);
-         
-         sprintf(buf, "%2.2d:%2.2d:%2.2d,%3.3ld ",
-                 tm->tm_hour, tm->tm_min, tm->tm_sec, 
-                 tp.tv_usec / 1000);
+         std::lock_guard<std::mutex> lock(logMutex);
+
+         flushLogQueue();
+         writeMessage(t);
       }
+      else
+         logDropped++;
 
-      printf("%s%s\n", buf, t);
+      free(t);
    }
    else
-      syslog(LOG_ERR, "%s", t);
+      logCondition.notify_one();
 
-   va_end(ap);
+   errno = errnoOrg;
 }
 
 //***************************************************************************
@@ -469,6 +716,123 @@ char* sstrcpy(char* dest, const char* src, int max)
    return dest;
 }
 
+//***************************************************************************
+// URL Encoding
+//  - percent encoding like curl_easy_(un)escape, but without allocations:
+//    unescape works in place, escape writes to the buffer of the caller
+//***************************************************************************
+
+static inline int hexValue(char c)
+{
+   if (c >= '0' && c <= '9') return c - '0';
+   if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+   if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+
+   return na;
+}
+
+static inline int isUnreserved(unsigned char c)
+{
+   return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+      || c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+char* urlUnescape(char* buf)
+{
+   char* s;
+   char* d;
+
+   // the (vectorized) strchr skips the runs without escapes
+
+   if (!buf || !(s = strchr(buf, '%')))
+      return buf;
+
+   d = s;
+
+   while (*s)
+   {
+      int hi, lo;
+
+      if (*s == '%' && (hi = hexValue(s[1])) != na && (lo = hexValue(s[2])) != na)
+      {
+         *d++ = hi << 4 | lo;
+         s += 3;
+      }
+      else
+      {
+         const char* next = strchr(s+1, '%');
+         size_t len = next ? next - s : strlen(s);
+
+         memmove(d, s, len);
+         d += len;
+         s += len;
+      }
+   }
+
+   *d = 0;
+
+   return buf;
+}
+
+int urlEscape(char* dest, int max, const char* src)
+{
+   static const char hex[] = "0123456789ABCDEF";
+   const unsigned char* s = (const unsigned char*)src;
+   const unsigned char* sEnd = s + strlen(src);
+   char* d = dest;
+   char* end = dest + max - 1;          // keep space for the terminator
+
+   while (*s)
+   {
+#ifdef __SSE2__
+      // copy blocks of 16 alphanumerics at once
+
+      while (end - d >= 16 && sEnd - s >= 16)
+      {
+         __m128i b = _mm_loadu_si128((const __m128i*)s);
+         __m128i l = _mm_or_si128(b, _mm_set1_epi8(0x20));
+
+         __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(b, _mm_set1_epi8('0'-1)),
+                                       _mm_cmplt_epi8(b, _mm_set1_epi8('9'+1)));
+         __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(l, _mm_set1_epi8('a'-1)),
+                                       _mm_cmplt_epi8(l, _mm_set1_epi8('z'+1)));
+
+         if (_mm_movemask_epi8(_mm_or_si128(digit, alpha)) != 0xFFFF)
+            break;
+
+         _mm_storeu_si128((__m128i*)d, b);
+         s += 16;
+         d += 16;
+      }
+
+      if (!*s)
+         break;
+#endif
+
+      if (isUnreserved(*s))
+      {
+         if (d >= end)
+            break;
+
+         *d++ = *s++;
+      }
+      else
+      {
+         if (end - d < 3)
+            break;
+
+         *d++ = '%';
+         *d++ = hex[*s >> 4];
+         *d++ = hex[*s & 0x0F];
+         s++;
+      }
+   }
+
+   *d = 0;
+
+   return *s ? fail : d - dest;
+}
+
 //***************************************************************************
 // Check Dir
 //***************************************************************************
@@ -95,6 +95,10 @@ struct MemoryStruct
 
 //***************************************************************************
 // Tell
+//  - the level is checked before the arguments are evaluated, a disabled
+//    level costs only the compare
+//  - while the log thread is running the message is only formatted and
+//    queued, the thread writes it to syslog / stdout
 //***************************************************************************
 
 enum Eloquence
@@ -107,7 +111,14 @@ enum Eloquence
    eloDebug3                 // 4
 };
 
-void tell(int eloquence, const char* format, ...);
+void tellMessage(int eloquence, const char* format, ...);
+
+#define tell(eloquence, ...) \
+   do { if (loglevel >= (eloquence)) tellMessage(eloquence, __VA_ARGS__); } while (0)
+
+int startLogThread();
+void stopLogThread();
+void logAfterFork();
 
 //***************************************************************************
 // Tools
@@ -131,6 +142,8 @@ char* lTrim(char* buf);
 char* allTrim(char* buf);
 int isNum(const char* value);
 char* sstrcpy(char* dest, const char* src, int max);
+char* urlUnescape(char* buf);                               // in place
+int urlEscape(char* dest, int max, const char* src);        // length or fail if 'max' is too small
 std::string num2Str(int num);
 std::string num2Str(double num);
 std::string l2pTime(time_t t);
@@ -0,0 +1,243 @@
+/*
+ * stats.c
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <time.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "stats.h"
+
+//***************************************************************************
+// Latency Statistic
+//***************************************************************************
+
+LatencyStat::LatencyStat(const char* aName)
+{
+   sstrcpy(name, aName, sizeof(name));
+   reset();
+}
+
+void LatencyStat::reset()
+{
+   for (int i = 0; i < sizeBuckets; i++)
+      buckets[i] = 0;
+
+   count = 0;
+   sum = 0;
+   maxUs = 0;
+}
+
+//***************************************************************************
+// Add
+//***************************************************************************
+
+void LatencyStat::add(uint64_t us)
+{
+   uint64_t m = maxUs.load(std::memory_order_relaxed);
+
+   buckets[toBucket(us)].fetch_add(1, std::memory_order_relaxed);
+   count.fetch_add(1, std::memory_order_relaxed);
+   sum.fetch_add(us, std::memory_order_relaxed);
+
+   while (us > m && !maxUs.compare_exchange_weak(m, us, std::memory_order_relaxed))
+      ;
+}
+
+//***************************************************************************
+// Bucket
+//  - values below 4us get their own bucket, above that each power of two
+//    is split into 'subBuckets' linear steps
+//***************************************************************************
+
+int LatencyStat::toBucket(uint64_t us)
+{
+   if (us < subBuckets)
+      return us;
+
+   int msb = 63 - __builtin_clzll(us);
+   int sub = (us >> (msb - 2)) & (subBuckets - 1);
+   int bucket = (msb - 1) * subBuckets + sub;
+
+   return bucket < sizeBuckets ? bucket : sizeBuckets - 1;
+}
+
+uint64_t LatencyStat::fromBucket(int bucket)
+{
+   if (bucket < subBuckets)
+      return bucket;
+
+   int msb = bucket / subBuckets + 1;
+   int sub = bucket % subBuckets;
+
+   // middle of the bucket
+
+   return ((uint64_t)(subBuckets + sub) << (msb - 2)) + ((1ULL << (msb - 2)) / 2);
+}
+
+//***************************************************************************
+// Percentile
+//***************************************************************************
+
+uint64_t LatencyStat::percentile(double p)
+{
+   uint64_t total = 0;
+   uint64_t seen = 0;
+
+   for (int i = 0; i < sizeBuckets; i++)
+      total += buckets[i];
+
+   if (!total)
+      return 0;
+
+   for (int i = 0; i < sizeBuckets; i++)
+   {
+      seen += buckets[i];
+
+      if (seen >= total * p)
+         return std::min(fromBucket(i), (uint64_t)maxUs);
+   }
+
+   return maxUs;
+}
+
+//***************************************************************************
+// Statistics
+//***************************************************************************
+
+std::vector<LatencyStat*> Statistics::stats;
+std::unordered_map<std::string,LatencyStat*> Statistics::index;
+std::map<std::string,EventCounter*> Statistics::counters;
+std::mutex Statistics::mutex;
+
+LatencyStat* Statistics::get(const char* name)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   auto it = index.find(name);
+
+   if (it != index.end())
+      return it->second;
+
+   // the statistics are never deleted, callers keep the pointer
+
+   stats.push_back(new LatencyStat(name));
+   index[name] = stats.back();
+
+   return stats.back();
+}
+
+//***************************************************************************
+// Counter
+//  - increment() looks the counter up by the name under the mutex, fine
+//    for rare events (log lines, restarts), the hot paths keep the
+//    pointer of getCounter() in a function local static
+//***************************************************************************
+
+EventCounter* Statistics::getCounter(const char* name)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   EventCounter*& c = counters[name];
+
+   if (!c)
+      c = new EventCounter;       // never deleted, like the statistics
+
+   return c;
+}
+
+void Statistics::increment(const char* name, uint64_t count)
+{
+   getCounter(name)->add(count);
+}
+
+uint64_t Statistics::counter(const char* name)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   auto it = counters.find(name);
+
+   return it != counters.end() ? it->second->get() : 0;
+}
+
+void Statistics::reset()
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   for (auto it = stats.begin(); it != stats.end(); ++it)
+      (*it)->reset();
+
+   for (auto it = counters.begin(); it != counters.end(); ++it)
+      it->second->reset();
+}
+
+uint64_t Statistics::usNow()
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+//***************************************************************************
+// Dump
+//***************************************************************************
+
+std::string Statistics::dump()
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   std::string result;
+   char line[200+TB];
+
+   snprintf(line, 200, "%-24s %9s %10s %10s %10s %10s %10s\n",
+            "name", "count", "avg[ms]", "p50[ms]", "p90[ms]", "p99[ms]", "max[ms]");
+   result = line;
+
+   for (auto it = stats.begin(); it != stats.end(); ++it)
+   {
+      LatencyStat* s = *it;
+      uint64_t count = s->getCount();
+
+      snprintf(line, 200, "%-24s %9llu %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+               s->getName(), (unsigned long long)count,
+               count ? s->getSum() / (double)count / 1000.0 : 0.0,
+               s->percentile(0.50) / 1000.0,
+               s->percentile(0.90) / 1000.0,
+               s->percentile(0.99) / 1000.0,
+               s->getMax() / 1000.0);
+
+      result += line;
+   }
+
+   if (counters.size())
+   {
+      snprintf(line, 200, "\n%-24s %9s %10s\n", "counter", "count", "hits[%]");
+      result += line;
+   }
+
+   // the hit ratio with the '...Hits' counter of a '...Hits' / '...Misses' pair
+
+   for (auto it = counters.begin(); it != counters.end(); ++it)
+   {
+      const std::string& name = it->first;
+      uint64_t count = it->second->get();
+      size_t pos = name.rfind("Hits");
+
+      if (pos != std::string::npos && pos + 4 == name.length())
+      {
+         auto misses = counters.find(name.substr(0, pos) + "Misses");
+         uint64_t all = count + (misses != counters.end() ? misses->second->get() : 0);
+
+         snprintf(line, 200, "%-24s %9llu %10.1f\n", name.c_str(), (unsigned long long)count,
+                  all ? count * 100.0 / all : 0.0);
+      }
+      else
+         snprintf(line, 200, "%-24s %9llu\n", name.c_str(), (unsigned long long)count);
+
+      result += line;
+   }
+
+   return result;
+}
@@ -0,0 +1,131 @@
+/*
+ * stats.h
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __STATS_H
+#define __STATS_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+
+//***************************************************************************
+// Latency Statistic
+//  - log-linear histogram of durations in [us], 4 buckets per power of two,
+//    updated lock free so it can stay enabled in the hot paths
+//***************************************************************************
+
+class LatencyStat
+{
+   public:
+
+      enum Misc
+      {
+         subBuckets  = 4,
+         sizeBuckets = 40 * subBuckets,
+         sizeName    = 50
+      };
+
+      LatencyStat(const char* aName);
+
+      void add(uint64_t us);
+      void reset();
+
+      uint64_t percentile(double p);      // [us], 0.0 .. 1.0
+      const char* getName()               { return name; }
+      uint64_t getCount()                 { return count; }
+      uint64_t getSum()                   { return sum; }
+      uint64_t getMax()                   { return maxUs; }
+
+   private:
+
+      static int toBucket(uint64_t us);
+      static uint64_t fromBucket(int bucket);
+
+      char name[sizeName+TB];
+      std::atomic<uint32_t> buckets[sizeBuckets];
+      std::atomic<uint64_t> count;
+      std::atomic<uint64_t> sum;
+      std::atomic<uint64_t> maxUs;
+};
+
+//***************************************************************************
+// Event Counter
+//  - lock free like the latency statistic, for the hot paths resolve it
+//    once per call site
+//***************************************************************************
+
+class EventCounter
+{
+   public:
+
+      EventCounter()                     { value = 0; }
+
+      void add(uint64_t count = 1)       { value.fetch_add(count, std::memory_order_relaxed); }
+      uint64_t get()                     { return value.load(std::memory_order_relaxed); }
+      void reset()                       { value = 0; }
+
+   private:
+
+      std::atomic<uint64_t> value;
+};
+
+//***************************************************************************
+// Statistics
+//  - process wide registry of the latency statistics and event counters
+//***************************************************************************
+
+class Statistics
+{
+   public:
+
+      static LatencyStat* get(const char* name);   // created on first use, resolve once per call site
+      static EventCounter* getCounter(const char* name);   // created on first use
+      static void increment(const char* name, uint64_t count = 1);
+      static uint64_t counter(const char* name);
+      static void reset();
+      static std::string dump();
+
+      static uint64_t usNow();
+
+   private:
+
+      static std::vector<LatencyStat*> stats;      // in order of creation
+      static std::unordered_map<std::string,LatencyStat*> index;
+      static std::map<std::string,EventCounter*> counters;
+      static std::mutex mutex;
+};
+
+//***************************************************************************
+// Latency Probe
+//  - adds the lifetime of the object to the statistic (like LogDuration)
+//  - takes the statistic resolved once by the caller, like
+//      static LatencyStat* stat = Statistics::get("osd.full");
+//      LatencyProbe probe(stat);
+//***************************************************************************
+
+class LatencyProbe
+{
+   public:
+
+      LatencyProbe(LatencyStat* aStat)  { stat = aStat; start = Statistics::usNow(); }
+      ~LatencyProbe()                   { stat->add(Statistics::usNow() - start); }
+
+   protected:
+
+      LatencyStat* stat;
+      uint64_t start;
+};
+
+//***************************************************************************
+#endif // __STATS_H
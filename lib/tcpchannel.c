@@ -9,7 +9,9 @@
 //***************************************************************************
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 
 #include <unistd.h>
@@ -39,6 +41,7 @@ TcpChannel::TcpChannel(int aTimeout, int aHandle)
 
    nTtlSent = 0;
    nTtlReceived = 0;
+   noDelay = no;
 
    lookAheadChar = false;
    lookAhead = 0;
@@ -47,6 +50,7 @@ TcpChannel::TcpChannel(int aTimeout, int aHandle)
    readBuffer = (char*)malloc(readBufferSize+TB);
    *readBuffer = 0;
    readBufferPending = 0;
+   readBufferStart = 0;
 }
 
 TcpChannel::~TcpChannel()
@@ -239,6 +243,9 @@ int TcpChannel::open(unsigned short aPort, const char* aHost)
    handle = aHandle;
    port   = aPort;
 
+   if (noDelay)
+      setNoDelay(yes);
+
    return success;
 }
 
@@ -258,6 +265,7 @@ int TcpChannel::flush()
 
    *readBuffer = 0;
    readBufferPending = 0;
+   readBufferStart = 0;
    lookAhead = false;
 
    return done;
@@ -367,6 +375,24 @@ char* TcpChannel::readln()
       nReceived++;
    }
    
+   // a complete line may already be pending from the last read
+
+   if (nReceived && (end = (char*)memchr(readBuffer, '\n', nReceived)))
+   {
+      char* line;
+      int lineSize = end - readBuffer;
+
+      *end = 0;                    // terminate line
+      line = strdup(readBuffer);
+
+      readBufferPending = nReceived - lineSize-1;
+      memmove(readBuffer, readBuffer+lineSize+1, readBufferPending);
+
+      nTtlReceived += lineSize+1;
+
+      return line;
+   }
+
    while (true)
    {
       // need resize ?
@@ -458,6 +484,199 @@ char* TcpChannel::readln()
    return 0;
 }
 
+//***************************************************************************
+// Read Block
+//  - read exactly 'size' bytes, data already buffered by readln() first
+//***************************************************************************
+
+int TcpChannel::readBlock(char* buf, int size)
+{
+   struct timeval tv;
+   fd_set readFD;
+   int nfds, result;
+   int nReceived = 0;
+
+   if (!handle)
+      return fail;
+
+   if (readBufferPending)
+   {
+      nReceived = readBufferPending < size ? readBufferPending : size;
+      memcpy(buf, readBuffer, nReceived);
+      readBufferPending -= nReceived;
+      memmove(readBuffer, readBuffer+nReceived, readBufferPending);
+   }
+
+   if (lookAhead && nReceived < size)
+   {
+      buf[nReceived++] = lookAheadChar;
+      lookAhead = false;
+   }
+
+   while (nReceived < size)
+   {
+      result = ::read(handle, buf + nReceived, size - nReceived);
+
+      if (result > 0)
+      {
+         nReceived += result;
+         continue;
+      }
+
+      if (result == 0)
+      {
+         // connection closed -> eof received
+
+         tell(eloAlways, "Error: Read failed, connection closed by server");
+         return errConnectionClosed;
+      }
+
+      if (errno != EWOULDBLOCK)
+         return checkErrno();
+
+      // time-out for select
+
+      tv.tv_sec  = timeout;
+      tv.tv_usec = 0;
+
+      FD_ZERO(&readFD);
+      FD_SET(handle, &readFD);
+
+      if ((nfds = ::select(handle+1, &readFD, NULL, NULL, &tv)) < 0)
+         return checkErrno();
+
+      // no event occured -> timeout
+
+      if (nfds == 0)
+      {
+         tell(eloAlways, "Error: Read failed, timeout after %d of %d bytes", nReceived, size);
+         return wrnTimeout;
+      }
+   }
+
+   nTtlReceived += nReceived;
+
+   return success;
+}
+
+//***************************************************************************
+// Read Token
+//  - next blank separated token of the current line, 'last' is set with
+//    the final token of the line. The tokens are taken from the socket
+//    data as it arrives, the line is never completely buffered.
+//  - don't mix with readln() until the last token of the line is read
+//***************************************************************************
+
+int TcpChannel::readToken(char* token, int max, int& last)
+{
+   const int minBufferSize = 65536;
+   struct timeval tv;
+   fd_set readFD;
+   int nfds, result;
+
+   last = no;
+   *token = 0;
+
+   if (!handle)
+      return fail;
+
+   if (readBufferSize < minBufferSize)
+   {
+      readBufferSize = minBufferSize;
+      readBuffer = (char*)realloc(readBuffer, readBufferSize+TB);
+   }
+
+   if (lookAhead)
+   {
+      readBuffer[readBufferPending++] = lookAheadChar;
+      lookAhead = false;
+   }
+
+   while (true)
+   {
+      char* start = readBuffer + readBufferStart;
+      char* stop = readBuffer + readBufferPending;
+      char* p = start;
+
+      while (p < stop && *p != ' ' && *p != '\n')
+         p++;
+
+      if (p < stop)
+      {
+         int len = p - start;
+
+         sprintf(token, "%.*s", len < max ? len : max, start);
+
+         last = *p == '\n';
+         readBufferStart += len + 1;
+         nTtlReceived += len + 1;
+
+         if (last)
+            compactReadBuffer();
+
+         return success;
+      }
+
+      // need more data, keep the pending part of the token and read the next chunk
+
+      compactReadBuffer();
+
+      if (readBufferSize - readBufferPending < minBufferSize / 4)
+      {
+         readBufferSize *= 2;
+         readBuffer = (char*)realloc(readBuffer, readBufferSize+TB);
+      }
+
+      result = ::read(handle, readBuffer + readBufferPending, readBufferSize - readBufferPending);
+
+      if (result > 0)
+      {
+         readBufferPending += result;
+         readBuffer[readBufferPending] = 0;
+         continue;
+      }
+
+      if (result == 0)
+      {
+         tell(eloAlways, "Error: Read failed, connection closed by server");
+         return errConnectionClosed;
+      }
+
+      if (errno != EWOULDBLOCK)
+         return checkErrno();
+
+      // time-out for select
+
+      tv.tv_sec  = timeout;
+      tv.tv_usec = 0;
+
+      FD_ZERO(&readFD);
+      FD_SET(handle, &readFD);
+
+      if ((nfds = ::select(handle+1, &readFD, NULL, NULL, &tv)) < 0)
+         return checkErrno();
+
+      // no event occured -> timeout
+
+      if (nfds == 0)
+      {
+         tell(eloAlways, "Error: Read failed, timeout while waiting for the next token");
+         return wrnTimeout;
+      }
+   }
+}
+
+void TcpChannel::compactReadBuffer()
+{
+   if (!readBufferStart)
+      return;
+
+   readBufferPending -= readBufferStart;
+   memmove(readBuffer, readBuffer + readBufferStart, readBufferPending);
+   readBuffer[readBufferPending] = 0;
+   readBufferStart = 0;
+}
+
 //***************************************************************************
 // Look
 //***************************************************************************
@@ -718,6 +937,145 @@ int TcpChannel::write(const char* buf, int bufLen)
    return success;
 }
 
+//***************************************************************************
+// Write Vector
+//  - the parts are sent with one writev(), only a partial write
+//    (full socket buffer) needs further calls
+//***************************************************************************
+
+int TcpChannel::writev(const struct iovec* iov, int count)
+{
+   const int sizeMaxParts = 16;
+   struct iovec parts[sizeMaxParts];
+   struct iovec* p = parts;
+   int result;
+   int bufLen = 0;
+   int nSent = 0;
+
+   if (!handle || count > sizeMaxParts)
+      return fail;
+
+#ifdef VDR_PLUGIN
+   cMutexLock lock(&_mutex);
+#endif
+
+   for (int i = 0; i < count; i++)
+   {
+      parts[i] = iov[i];
+      bufLen += iov[i].iov_len;
+   }
+
+   if (loglevel >= eloDebug2)
+   {
+      std::string buf;
+
+      for (int i = 0; i < count; i++)
+         buf.append((const char*)iov[i].iov_base, iov[i].iov_len);
+
+      tell(eloDebug2, "-> [%s]", buf.c_str());
+   }
+
+   while (nSent < bufLen)
+   {
+      result = ::writev(handle, p, count);
+
+      if (result < 0)
+      {
+         if (errno != EWOULDBLOCK)
+            return checkErrno();
+
+         if ((result = waitWritable()) != success)
+            return result;
+
+         continue;
+      }
+
+      nSent += result;
+
+      // skip the parts already sent
+
+      while (count && (size_t)result >= p->iov_len)
+      {
+         result -= p->iov_len;
+         p++;
+         count--;
+      }
+
+      if (count)
+      {
+         p->iov_base = (char*)p->iov_base + result;
+         p->iov_len -= result;
+      }
+   }
+
+   // increase send counter
+
+   nTtlSent += nSent;
+
+   return success;
+}
+
+//***************************************************************************
+// Wait Writable
+//***************************************************************************
+
+int TcpChannel::waitWritable()
+{
+   struct timeval wait;
+   fd_set writeFD;
+   int nfds;
+
+   // time-out for select
+
+   wait.tv_sec  = timeout;
+   wait.tv_usec = 0;
+
+   // clear and set file-descriptors
+
+   FD_ZERO(&writeFD);
+   FD_SET(handle, &writeFD);
+
+   // look event
+
+   if ((nfds = ::select(handle+1, 0, &writeFD, 0, &wait)) < 0)
+   {
+      // Error: Select failed
+
+      return checkErrno();
+   }
+
+   // no event occured -> timeout
+
+   if (nfds == 0)
+      return wrnTimeout;
+
+   return success;
+}
+
+//***************************************************************************
+// Set No Delay
+//  - disable Nagle, the small request lines shouldn't wait for the
+//    (delayed) ACK of the previous segment
+//***************************************************************************
+
+int TcpChannel::setNoDelay(int on)
+{
+   int flag = on ? 1 : 0;
+
+   noDelay = on;
+
+   if (!handle)
+      return done;
+
+   if (setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag)) < 0)
+   {
+      tell(eloAlways, "Error: Setting TCP_NODELAY failed, errno (%d)", errno);
+      return fail;
+   }
+
+   return success;
+}
+
 //***************************************************************************
 // Close
 //***************************************************************************
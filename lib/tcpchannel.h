@@ -13,6 +13,8 @@
 #ifndef __GTFT_TCPCHANNEL_H__
 #define __GTFT_TCPCHANNEL_H__
 
+#include <sys/uio.h>
+
 #include <vdr/thread.h>
 
 #include "common.h"
@@ -70,17 +72,27 @@ class TcpChannel
 		int listen(TcpChannel*& child);
       int look(uint64_t aTimeout = 0);
       int read(char* buf, int bufLen, int ln = no);
+      int readBlock(char* buf, int size);
       char* readln();
+      int readToken(char* token, int max, int& last);
 
       int writeCmd(int command, const char* buf = 0, int bufLen = 0);
       int write(const char* buf, int bufLen = 0);
+      int writev(const struct iovec* iov, int count);    // all parts with one syscall (if possible)
+      int setNoDelay(int on);                             // TCP_NODELAY, kept for the next open()
 
       int isConnected()    { return handle != 0; }
       int getHandle()      { return handle; }
 
+      // a complete line is already buffered (readln() will not block)
+
+      int hasLine()        { return readBufferPending && memchr(readBuffer, '\n', readBufferPending); }
+
    private:
 
       int checkErrno();
+      int waitWritable();
+      void compactReadBuffer();
 
       // data
 
@@ -95,10 +107,12 @@ class TcpChannel
       int lookAhead;
       int nTtlReceived;
       int nTtlSent;
+      int noDelay;
 
       char* readBuffer;
       int readBufferSize;
       int readBufferPending;
+      int readBufferStart;         // consumed part of a line read by readToken()
 
 #ifdef VDR_PLUGIN
       cMutex _mutex;
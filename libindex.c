@@ -0,0 +1,772 @@
+/*
+ * libindex.c
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+
+#include "lib/common.h"
+
+#include "config.h"
+#include "lmcmanager.h"
+#include "libindex.h"
+
+char* cLibraryIndex::directory = 0;
+cLibraryIndex::MappingPtr cLibraryIndex::mapping;
+cLibraryIndexer* cLibraryIndex::indexer = 0;
+cMutex cLibraryIndex::searchMutex;
+cLibraryIndex::MappingPtr cLibraryIndex::searchMapping;
+std::unordered_map<uint32_t,std::vector<uint32_t>> cLibraryIndex::trigrams;
+std::string cLibraryIndex::names;
+std::vector<uint32_t> cLibraryIndex::nameOffsets;
+
+static const char magicIndex[4] = { 'S', 'Q', 'L', 'I' };
+
+//***************************************************************************
+// Mapping
+//***************************************************************************
+
+cLibraryIndex::Mapping::Mapping(const char* aData, size_t aSize)
+{
+   data = aData;
+   size = aSize;
+   header = (const Header*)data;
+   genres = (const Entry*)(data + sizeof(Header));
+   artists = genres + header->genreCount;
+   albums = (const Album*)(artists + header->artistCount);
+   tracks = (const Track*)(albums + header->albumCount);
+   strings = (const char*)(tracks + header->trackCount);
+}
+
+cLibraryIndex::Mapping::~Mapping()
+{
+   munmap((void*)data, size);
+}
+
+//***************************************************************************
+// Directory
+//***************************************************************************
+
+void cLibraryIndex::setDirectory(const char* aDirectory)
+{
+   free(directory);
+   directory = aDirectory ? strdup(aDirectory) : 0;
+}
+
+std::string cLibraryIndex::path()
+{
+   return std::string(directory) + "/library.idx";
+}
+
+long cLibraryIndex::getLastScan()
+{
+   MappingPtr m = std::atomic_load(&mapping);
+
+   return m ? m->header->lastScan : na;
+}
+
+//***************************************************************************
+// Load
+//***************************************************************************
+
+int cLibraryIndex::load()
+{
+   struct stat st;
+   int fd;
+   const char* data;
+   const Header* header;
+
+   if (!directory)
+      return fail;
+
+   if ((fd = open(path().c_str(), O_RDONLY)) < 0)
+      return fail;                                 // not build yet
+
+   if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header))
+   {
+      ::close(fd);
+      return fail;
+   }
+
+   data = (const char*)mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   ::close(fd);
+
+   if (data == MAP_FAILED)
+   {
+      tell(eloAlways, "Error: Mapping '%s' failed, %m", path().c_str());
+      return fail;
+   }
+
+   header = (const Header*)data;
+
+   if (memcmp(header->magic, magicIndex, sizeof(magicIndex)) != 0 || header->format != format
+       || header->genreCount < 0 || header->artistCount < 0 || header->albumCount < 0 || header->trackCount < 0
+       || sizeof(Header) + (header->genreCount + header->artistCount) * sizeof(Entry)
+          + header->albumCount * sizeof(Album) + header->trackCount * sizeof(Track)
+          + header->stringsSize != (size_t)st.st_size)
+   {
+      tell(eloAlways, "Ignoring library index '%s', format or size doesn't match", path().c_str());
+      munmap((void*)data, st.st_size);
+      return fail;
+   }
+
+   std::atomic_store(&mapping, MappingPtr(new Mapping(data, st.st_size)));
+
+   tell(eloAlways, "Library index with %d genres, %d artists, %d albums and %d tracks loaded",
+        header->genreCount, header->artistCount, header->albumCount, header->trackCount);
+
+   return success;
+}
+
+//***************************************************************************
+// Create
+//  - sort and link the tracks of the LMS, write the file (temporary
+//    first) and map it
+//***************************************************************************
+
+int cLibraryIndex::create(const LmcCom::LibraryTracks* tracks, long lastScan)
+{
+   std::map<int,const LmcCom::LibraryTrack*> genreMap, artistMap, albumMap;   // id -> first track
+   std::map<int,int> genreIdx, artistIdx, albumIdx;                            // id -> index
+   std::vector<int> genreIds, artistIds, albumIds;
+   std::vector<const LmcCom::LibraryTrack*> sorted;
+   std::string strings(1, '\0');                                               // offset 0 is ""
+   Header header;
+   FILE* fp;
+
+   if (!directory)
+      return fail;
+
+   auto store = [&strings](const std::string& s) -> uint32_t
+   {
+      if (s.empty())
+         return 0;
+
+      uint32_t offset = strings.size();
+      strings.append(s.c_str(), s.length() + 1);
+      return offset;
+   };
+
+   // distinct genres, artists and albums, ordered by name in the order of
+   //  the locale, the collation keys are computed once per name
+
+   for (auto it = tracks->begin(); it != tracks->end(); ++it)
+   {
+      if (it->genreId)  genreMap.insert(std::make_pair(it->genreId, &(*it)));
+      if (it->artistId) artistMap.insert(std::make_pair(it->artistId, &(*it)));
+      if (it->albumId)  albumMap.insert(std::make_pair(it->albumId, &(*it)));
+   }
+
+   auto order = [](std::map<int,const LmcCom::LibraryTrack*>& map, std::vector<int>& ids,
+                   std::map<int,int>& idx, std::function<const std::string&(const LmcCom::LibraryTrack*)> name)
+   {
+      std::vector<std::pair<std::string,int>> keys;
+
+      for (auto it = map.begin(); it != map.end(); ++it)
+         keys.push_back(std::make_pair(LmcCom::collationKey(name(it->second).c_str()), it->first));
+
+      std::stable_sort(keys.begin(), keys.end(), [](const std::pair<std::string,int>& a, const std::pair<std::string,int>& b)
+                       { return a.first < b.first; });
+
+      for (size_t i = 0; i < keys.size(); i++)
+      {
+         ids.push_back(keys[i].second);
+         idx[keys[i].second] = i;
+      }
+   };
+
+   order(genreMap, genreIds, genreIdx, [](const LmcCom::LibraryTrack* t) -> const std::string& { return t->genre; });
+   order(artistMap, artistIds, artistIdx, [](const LmcCom::LibraryTrack* t) -> const std::string& { return t->artist; });
+   order(albumMap, albumIds, albumIdx, [](const LmcCom::LibraryTrack* t) -> const std::string& { return t->album; });
+
+   // tracks by album (in name order), track number and title
+
+   struct TrackKey
+   {
+      int album;
+      int trackNum;
+      std::string title;             // collation key
+      const LmcCom::LibraryTrack* track;
+   };
+
+   std::vector<TrackKey> trackKeys;
+
+   trackKeys.reserve(tracks->size());
+
+   for (auto it = tracks->begin(); it != tracks->end(); ++it)
+      trackKeys.push_back({ it->albumId ? albumIdx[it->albumId] : na, it->trackNum,
+                            LmcCom::collationKey(it->title.c_str()), &(*it) });
+
+   std::stable_sort(trackKeys.begin(), trackKeys.end(), [](const TrackKey& a, const TrackKey& b)
+   {
+      if (a.album != b.album)
+         return a.album < b.album;
+
+      if (a.trackNum != b.trackNum)
+         return a.trackNum < b.trackNum;
+
+      return a.title < b.title;
+   });
+
+   for (auto it = trackKeys.begin(); it != trackKeys.end(); ++it)
+      sorted.push_back(it->track);
+
+   // write
+
+   std::string tmp = path() + ".tmp";
+
+   if (!(fp = fopen(tmp.c_str(), "w")))
+   {
+      tell(eloAlways, "Error: Can't write library index '%s', %m", tmp.c_str());
+      return fail;
+   }
+
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, magicIndex, sizeof(magicIndex));
+   header.format = format;
+   header.lastScan = lastScan;
+   header.genreCount = genreIds.size();
+   header.artistCount = artistIds.size();
+   header.albumCount = albumIds.size();
+   header.trackCount = sorted.size();
+
+   fwrite(&header, sizeof(header), 1, fp);
+
+   for (size_t i = 0; i < genreIds.size(); i++)
+   {
+      Entry e = { genreIds[i], store(genreMap[genreIds[i]]->genre) };
+      fwrite(&e, sizeof(e), 1, fp);
+   }
+
+   for (size_t i = 0; i < artistIds.size(); i++)
+   {
+      Entry e = { artistIds[i], store(artistMap[artistIds[i]]->artist) };
+      fwrite(&e, sizeof(e), 1, fp);
+   }
+
+   for (size_t i = 0; i < albumIds.size(); i++)
+   {
+      const LmcCom::LibraryTrack* t = albumMap[albumIds[i]];
+      Album a = { albumIds[i], store(t->album), t->year, store(t->artwork) };
+      fwrite(&a, sizeof(a), 1, fp);
+   }
+
+   for (size_t i = 0; i < sorted.size(); i++)
+   {
+      const LmcCom::LibraryTrack* t = sorted[i];
+      Track r;
+
+      r.id = t->id;
+      r.title = store(t->title);
+      r.album = t->albumId ? albumIdx[t->albumId] : na;
+      r.artist = t->artistId ? artistIdx[t->artistId] : na;
+      r.genre = t->genreId ? genreIdx[t->genreId] : na;
+      r.year = t->year;
+      r.trackNum = t->trackNum;
+
+      fwrite(&r, sizeof(r), 1, fp);
+   }
+
+   fwrite(strings.data(), 1, strings.size(), fp);
+
+   // header again, now with the size of the strings
+
+   header.stringsSize = strings.size();
+   fseek(fp, 0, SEEK_SET);
+   fwrite(&header, sizeof(header), 1, fp);
+
+   int error = ferror(fp);
+
+   if (fclose(fp) != 0 || error)
+   {
+      tell(eloAlways, "Error: Writing library index '%s' failed", tmp.c_str());
+      unlink(tmp.c_str());
+      return fail;
+   }
+
+   if (rename(tmp.c_str(), path().c_str()) != 0)
+   {
+      tell(eloAlways, "Error: Renaming '%s' failed, %m", tmp.c_str());
+      return fail;
+   }
+
+   RangeCache::clear();          // the menus switch to the index
+
+   return load();
+}
+
+//***************************************************************************
+// Query
+//  - like LmcCom::queryRange() for the library levels of the menu,
+//    fail if the index can't answer it (not loaded, unknown filter)
+//***************************************************************************
+
+int cLibraryIndex::query(LmcCom::RangeQueryType queryType, int from, int count,
+                         LmcCom::Parameters* filters, LmcCom::RangeList* list, int& total)
+{
+   MappingPtr m = std::atomic_load(&mapping);
+   const Mapping* map = m.get();
+   Filter filter;
+
+   if (!map || toFilter(map, filters, filter) != success)
+      return fail;
+
+   const Header* h = map->header;
+   int filtered = filter.genre != na || filter.artist != na || filter.album != na || filter.year != na;
+
+   list->clear();
+   total = 0;
+
+   switch (queryType)
+   {
+      case LmcCom::rqtGenres:
+      case LmcCom::rqtArtists:
+      case LmcCom::rqtAlbums:
+      {
+         const Entry* entries = queryType == LmcCom::rqtGenres ? map->genres : map->artists;
+         int entryCount = queryType == LmcCom::rqtGenres ? h->genreCount
+            : queryType == LmcCom::rqtArtists ? h->artistCount : h->albumCount;
+         std::vector<char> used(entryCount, !filtered);
+
+         // which are referenced by the filtered tracks
+
+         if (filtered)
+         {
+            for (int i = 0; i < h->trackCount; i++)
+            {
+               const Track* t = &map->tracks[i];
+               int idx = queryType == LmcCom::rqtGenres ? t->genre
+                  : queryType == LmcCom::rqtArtists ? t->artist : t->album;
+
+               if (idx != na && matches(t, filter))
+                  used[idx] = yes;
+            }
+         }
+
+         for (int i = 0; i < entryCount; i++)
+         {
+            if (!used[i])
+               continue;
+
+            if (queryType == LmcCom::rqtAlbums)
+               addItem(list, total, from, count, map->albums[i].id, map->str(map->albums[i].name));
+            else
+               addItem(list, total, from, count, entries[i].id, map->str(entries[i].name));
+         }
+
+         break;
+      }
+
+      case LmcCom::rqtYears:
+      {
+         std::vector<char> used(maxYear+1, no);
+
+         for (int i = 0; i < h->trackCount; i++)
+         {
+            const Track* t = &map->tracks[i];
+
+            if (t->year > 0 && t->year <= maxYear && matches(t, filter))
+               used[t->year] = yes;
+         }
+
+         for (int year = maxYear; year > 0; year--)          // latest first
+         {
+            if (used[year])
+               addItem(list, total, from, count, 0, std::to_string(year).c_str());
+         }
+
+         break;
+      }
+
+      case LmcCom::rqtTracks:
+      {
+         const Track* first = map->tracks;
+         const Track* last = map->tracks + h->trackCount;
+
+         // tracks are ordered by album, look up the range
+
+         if (filter.album != na)
+         {
+            first = std::lower_bound(first, last, filter.album, [](const Track& t, int album) { return t.album < album; });
+            last = std::upper_bound(first, last, filter.album, [](int album, const Track& t) { return album < t.album; });
+         }
+
+         for (const Track* t = first; t < last; t++)
+         {
+            if (matches(t, filter))
+               addItem(list, total, from, count, t->id, map->str(t->title));
+         }
+
+         break;
+      }
+
+      default:
+         return fail;
+   }
+
+   return success;
+}
+
+int cLibraryIndex::addItem(LmcCom::RangeList* list, int& total, int from, int count,
+                           int id, const char* content)
+{
+   if (total >= from && total < from + count)
+   {
+      LmcCom::ListItem item;
+
+      if (id)
+         item.id = std::to_string(id);
+
+      item.content = content;
+      item.isAudio = yes;
+
+      item.textKey = LmcCom::textKeyOf(content);
+
+      list->push_back(item);
+   }
+
+   total++;
+
+   return done;
+}
+
+//***************************************************************************
+// Search
+//  - artists, albums and tracks containing the term (case insensitive),
+//    the candidates come from the rarest trigram of the term and are
+//    verified against the name, shorter terms scan all names
+//  - the items get the filter tag of their type as command (artist_id,
+//    album_id or track_id), as LmcCom::search() does
+//***************************************************************************
+
+int cLibraryIndex::search(const char* term, int max, LmcCom::RangeList* list, int& total)
+{
+   cMutexLock lock(&searchMutex);
+   MappingPtr m = std::atomic_load(&mapping);
+   const std::vector<uint32_t>* candidates = 0;
+   std::string t;
+
+   list->clear();
+   total = 0;
+
+   if (!m)
+      return fail;
+
+   if (m != searchMapping)
+      buildTrigrams(m);
+
+   normalize(term, t);
+
+   if (t.length() >= 3)
+   {
+      for (size_t i = 0; i + 3 <= t.length(); i++)
+      {
+         uint32_t key = (uint8_t)t[i] << 16 | (uint8_t)t[i+1] << 8 | (uint8_t)t[i+2];
+         auto it = trigrams.find(key);
+
+         if (it == trigrams.end())
+            return success;                       // no name contains it
+
+         if (!candidates || it->second.size() < candidates->size())
+            candidates = &it->second;
+      }
+   }
+
+   const Header* h = m->header;
+   uint32_t count = candidates ? candidates->size() : nameOffsets.size();
+
+   for (uint32_t c = 0; c < count; c++)
+   {
+      uint32_t doc = candidates ? (*candidates)[c] : c;
+
+      if (!strstr(names.c_str() + nameOffsets[doc], t.c_str()))
+         continue;
+
+      if (total++ >= max)
+         continue;
+
+      LmcCom::ListItem item;
+      int idx = doc;
+
+      if (idx < h->artistCount)
+      {
+         item.id = std::to_string(m->artists[idx].id);
+         item.content = m->str(m->artists[idx].name);
+         item.command = "artist_id";
+         item.hasItems = yes;
+      }
+      else if ((idx -= h->artistCount) < h->albumCount)
+      {
+         item.id = std::to_string(m->albums[idx].id);
+         item.content = m->str(m->albums[idx].name);
+         item.command = "album_id";
+         item.hasItems = yes;
+      }
+      else
+      {
+         idx -= h->albumCount;
+         item.id = std::to_string(m->tracks[idx].id);
+         item.content = m->str(m->tracks[idx].title);
+         item.command = "track_id";
+      }
+
+      item.isAudio = yes;
+      list->push_back(item);
+   }
+
+   return success;
+}
+
+int cLibraryIndex::prepareSearch()
+{
+   cMutexLock lock(&searchMutex);
+   MappingPtr m = std::atomic_load(&mapping);
+
+   if (!m || m == searchMapping)
+      return done;
+
+   return buildTrigrams(m);
+}
+
+int cLibraryIndex::buildTrigrams(MappingPtr m)
+{
+   const Header* h = m->header;
+   uint64_t start = cTimeMs::Now();
+   std::string n;
+
+   trigrams.clear();
+   names.clear();
+   nameOffsets.clear();
+
+   for (int doc = 0; doc < h->artistCount + h->albumCount + h->trackCount; doc++)
+   {
+      int idx = doc;
+
+      if (idx < h->artistCount)
+         normalize(m->str(m->artists[idx].name), n);
+      else if ((idx -= h->artistCount) < h->albumCount)
+         normalize(m->str(m->albums[idx].name), n);
+      else
+         normalize(m->str(m->tracks[idx - h->albumCount].title), n);
+
+      nameOffsets.push_back(names.size());
+      names.append(n.c_str(), n.length() + 1);
+
+      for (size_t i = 0; i + 3 <= n.length(); i++)
+      {
+         uint32_t key = (uint8_t)n[i] << 16 | (uint8_t)n[i+1] << 8 | (uint8_t)n[i+2];
+         std::vector<uint32_t>& docs = trigrams[key];
+
+         if (docs.empty() || docs.back() != (uint32_t)doc)     // once per document
+            docs.push_back(doc);
+      }
+   }
+
+   searchMapping = m;
+
+   tell(eloDetail, "Search index of %zu names with %zu trigrams built in %ld ms",
+        nameOffsets.size(), trigrams.size(), (long)(cTimeMs::Now() - start));
+
+   return success;
+}
+
+void cLibraryIndex::normalize(const char* s, std::string& out)
+{
+   out.clear();
+
+   for (; *s; s++)
+      out += (*s & 0x80) ? *s : tolower(*s);
+}
+
+//***************************************************************************
+// Filter
+//  - the menu filters like 'genre_id:12' as indices of the index
+//***************************************************************************
+
+int cLibraryIndex::toFilter(const Mapping* m, LmcCom::Parameters* filters, Filter& filter)
+{
+   filter.genre = filter.artist = filter.album = filter.year = na;
+
+   if (!filters)
+      return success;
+
+   for (auto it = filters->begin(); it != filters->end(); ++it)
+   {
+      const char* p = strchr(it->c_str(), ':');
+
+      if (!p)
+         return fail;
+
+      std::string name(it->c_str(), p - it->c_str());
+      int value = atoi(p+1);
+      int* idx = 0;
+
+      if (name == "year")
+      {
+         filter.year = value;
+         continue;
+      }
+
+      if (name == "genre_id")
+      {
+         for (int i = 0; i < m->header->genreCount && !idx; i++)
+            if (m->genres[i].id == value) { filter.genre = i; idx = &filter.genre; }
+      }
+      else if (name == "artist_id")
+      {
+         for (int i = 0; i < m->header->artistCount && !idx; i++)
+            if (m->artists[i].id == value) { filter.artist = i; idx = &filter.artist; }
+      }
+      else if (name == "album_id")
+      {
+         for (int i = 0; i < m->header->albumCount && !idx; i++)
+            if (m->albums[i].id == value) { filter.album = i; idx = &filter.album; }
+      }
+
+      if (!idx)
+         return fail;        // unsupported filter (like sort:new) or unknown id
+   }
+
+   return success;
+}
+
+int cLibraryIndex::matches(const Track* t, const Filter& filter)
+{
+   return (filter.genre == na || t->genre == filter.genre)
+      && (filter.artist == na || t->artist == filter.artist)
+      && (filter.album == na || t->album == filter.album)
+      && (filter.year == na || t->year == filter.year);
+}
+
+//***************************************************************************
+// Indexer Steering
+//***************************************************************************
+
+int cLibraryIndex::startIndexer()
+{
+   if (indexer)
+      return done;
+
+   indexer = new cLibraryIndexer();
+   indexer->Start();
+
+   return success;
+}
+
+int cLibraryIndex::stopIndexer()
+{
+   delete indexer;
+   indexer = 0;
+
+   return success;
+}
+
+//***************************************************************************
+// Library Indexer
+//***************************************************************************
+
+cLibraryIndexer::cLibraryIndexer()
+   : cThread("squeezebox-indexer")
+{
+}
+
+cLibraryIndexer::~cLibraryIndexer()
+{
+   stop();
+}
+
+void cLibraryIndexer::stop()
+{
+   Cancel(-1);
+   waitCondition.Signal();
+
+   // no hard cancel, a running page query holds the lock of the shared
+   // connection, the indexing stops after it
+
+   while (Active())
+      cCondWait::SleepMs(10);
+}
+
+//***************************************************************************
+// Action
+//***************************************************************************
+
+void cLibraryIndexer::Action()
+{
+   LmcCom* lmc = LmcManager::acquire();
+
+   tell(eloDetail, "Library indexer started");
+
+   while (Running())
+   {
+      check(lmc);
+      cLibraryIndex::prepareSearch();     // not with the first search
+      waitCondition.Wait(cLibraryIndex::checkInterval * 1000);
+   }
+
+   LmcManager::release();
+
+   tell(eloDetail, "Library indexer stopped");
+}
+
+//***************************************************************************
+// Check
+//  - rebuild if the LMS scanned since the index was created, not while
+//    a scan is running
+//***************************************************************************
+
+int cLibraryIndexer::check(LmcCom* lmc)
+{
+   LmcCom::LibraryTracks tracks;
+   LmcCom::LibraryTracks page;
+   long lastScan;
+   int scanning;
+   int total = 0;
+   uint64_t start = cTimeMs::Now();
+
+   if (!lmc->isOpen() && lmc->open(cfg.lmcHost, cfg.lmcPort) != success)
+      return fail;
+
+   if (lmc->queryServerStatus(lastScan, scanning) != success)
+      return fail;
+
+   if (scanning || lastScan == cLibraryIndex::getLastScan())
+      return done;
+
+   tell(eloAlways, "Library changed, building the index (lastscan %ld)", lastScan);
+
+   for (int from = 0; Running(); from += cLibraryIndex::pageSize)
+   {
+      if (lmc->queryLibrary(from, cLibraryIndex::pageSize, &page, total) != success)
+         return fail;
+
+      tracks.insert(tracks.end(), page.begin(), page.end());
+
+      if ((int)page.size() < cLibraryIndex::pageSize || from + cLibraryIndex::pageSize >= total)
+         break;
+   }
+
+   if (!Running())
+      return done;
+
+   if (cLibraryIndex::create(&tracks, lastScan) != success)
+      return fail;
+
+   tell(eloAlways, "Library index of %d tracks built in %ld ms", (int)tracks.size(),
+        (long)(cTimeMs::Now() - start));
+
+   return success;
+}
@@ -0,0 +1,172 @@
+/*
+ * libindex.h
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __LIBINDEX_H
+#define __LIBINDEX_H
+
+#include <stdint.h>
+
+#include <memory>
+#include <unordered_map>
+
+#include <vdr/thread.h>
+
+#include "lmccom.h"
+
+//***************************************************************************
+// Library Index
+//  - local mirror of the LMS library: genres, artists, albums and tracks
+//    with their relations in one file of the plugin cache directory,
+//    mapped read only, the menus browse it without asking the LMS
+//  - rebuilt by the indexer if the last scan of the LMS changed, the new
+//    file replaces the mapping, readers keep the former one until done
+//***************************************************************************
+
+class cLibraryIndex
+{
+   public:
+
+      enum Misc
+      {
+         format        = 1,          // increment on any layout change
+         pageSize      = 1000,       // tracks per request while building
+         checkInterval = 60,         // [s] lastscan of the LMS
+         maxYear       = 9999
+      };
+
+      static void setDirectory(const char* aDirectory);
+
+      static int load();
+      static int create(const LmcCom::LibraryTracks* tracks, long lastScan);
+      static long getLastScan();
+
+      static int query(LmcCom::RangeQueryType queryType, int from, int count,
+                       LmcCom::Parameters* filters, LmcCom::RangeList* list, int& total);
+      static int search(const char* term, int max, LmcCom::RangeList* list, int& total);
+      static int prepareSearch();
+
+      // indexer
+
+      static int startIndexer();
+      static int stopIndexer();
+
+   protected:
+
+      struct Header
+      {
+         char magic[4];
+         uint32_t format;
+         int64_t lastScan;
+         int32_t genreCount;
+         int32_t artistCount;
+         int32_t albumCount;
+         int32_t trackCount;
+         uint32_t stringsSize;
+         int32_t reserved;
+      };
+
+      struct Entry                   // genre and artist, sorted by name
+      {
+         int32_t id;
+         uint32_t name;              // offset in the strings
+      };
+
+      struct Album                   // sorted by name
+      {
+         int32_t id;
+         uint32_t name;
+         int32_t year;
+         uint32_t artwork;
+      };
+
+      struct Track                   // sorted by album, track number and title
+      {
+         int32_t id;
+         uint32_t title;
+         int32_t album;              // index of album, artist and genre, na if unknown
+         int32_t artist;
+         int32_t genre;
+         int32_t year;
+         int32_t trackNum;
+      };
+
+      struct Filter
+      {
+         int genre;                  // indices, na for no filter
+         int artist;
+         int album;
+         int year;
+      };
+
+      class Mapping
+      {
+         public:
+
+            Mapping(const char* aData, size_t aSize);
+            ~Mapping();
+
+            const char* data;
+            size_t size;
+            const Header* header;
+            const Entry* genres;
+            const Entry* artists;
+            const Album* albums;
+            const Track* tracks;
+            const char* strings;
+
+            const char* str(uint32_t offset) const { return offset < header->stringsSize ? strings + offset : ""; }
+      };
+
+      typedef std::shared_ptr<const Mapping> MappingPtr;
+
+      static int addItem(LmcCom::RangeList* list, int& total, int from, int count,
+                         int id, const char* content);
+      static int buildTrigrams(MappingPtr m);
+      static void normalize(const char* s, std::string& out);
+      static int toFilter(const Mapping* m, LmcCom::Parameters* filters, Filter& filter);
+      static int matches(const Track* t, const Filter& filter);
+      static std::string path();
+
+      static char* directory;
+      static MappingPtr mapping;     // access by std::atomic_load/store only
+      static class cLibraryIndexer* indexer;
+
+      // search, trigrams of the artist, album and track names built with
+      //  the first search of a mapping (documents in this order)
+
+      static cMutex searchMutex;
+      static MappingPtr searchMapping;
+      static std::unordered_map<uint32_t,std::vector<uint32_t>> trigrams;
+      static std::string names;                  // normalized, 0 terminated
+      static std::vector<uint32_t> nameOffsets;  // by document
+};
+
+//***************************************************************************
+// Library Indexer
+//  - started with the plugin, checks the last scan of the LMS and
+//    rebuilds the index in the background if it changed
+//***************************************************************************
+
+class cLibraryIndexer : public cThread
+{
+   public:
+
+      cLibraryIndexer();
+      virtual ~cLibraryIndexer();
+
+      void stop();
+
+   protected:
+
+      virtual void Action();
+      int check(LmcCom* lmc);
+
+      cCondWait waitCondition;
+};
+
+//***************************************************************************
+#endif // __LIBINDEX_H
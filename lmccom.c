@@ -10,8 +10,10 @@
 #endif
 
 #include "lib/common.h"
+#include "lib/stats.h"
 #include "lmccom.h"
 #include "lmctag.h"
+#include "lmcjson.h"
 
 //***************************************************************************
 // Object
@@ -20,13 +22,15 @@
 LmcCom::LmcCom(const char* aMac)
    : TcpChannel()
 {
-   // init curl, used only for (de)escape the url encoding
-
-   curl_global_init(CURL_GLOBAL_NOTHING);
-   curl = curl_easy_init();
-
    queryTitle = 0;
    notify = 0;
+   json = 0;
+   notifiedAt = 0;
+   trackListener = 0;
+   snapshotVersion = 0;
+   snapshot = SnapshotPtr(new PlaylistSnapshot);
+   transport = ttCli;
+   httpPort = 9000;
    port = 0;
    host = 0;
    mac = 0;
@@ -47,7 +51,7 @@ LmcCom::~LmcCom()
 {
    if (notify) stopNotify();
 
-   curl_easy_cleanup(curl);
+   delete json;
    close();
    free(host);
    free(mac);
@@ -63,13 +67,55 @@ int LmcCom::open(const char* aHost, unsigned short aPort)
 {
    LmcLock;
 
+   // the connection is shared, the 'if (!isOpen()) open()' of another
+   // thread may have been faster
+
+   if (isOpen() && host && aPort == port && strcmp(host, aHost) == 0)
+      return done;
+
    free(host);
    port = aPort;
    host = strdup(aHost);
 
+   if (json && json->open(host, httpPort) != success)
+   {
+      tell(eloAlways, "Error: Opening JSON-RPC connection to '%s:%d' failed", host, httpPort);
+      return fail;
+   }
+
    return TcpChannel::open(port, host);
 }
 
+//***************************************************************************
+// Set Transport
+//  - notifications are still received by the CLI (listen), the
+//    commands and queries are routed by the selected transport
+//***************************************************************************
+
+void LmcCom::setTransport(int aTransport, unsigned short aHttpPort)
+{
+   LmcLock;
+
+   transport = aTransport;
+   httpPort = aHttpPort;
+
+   delete json;
+   json = 0;
+
+   if (transport == ttJsonRpc)
+      json = new LmcJsonRpc();
+
+   tell(eloDetail, "Using %s transport for LMS requests", transport == ttJsonRpc ? "JSON-RPC" : "CLI");
+}
+
+LmcTag* LmcCom::newTag()
+{
+   if (transport == ttJsonRpc)
+      return new LmcJsonTag(this);
+
+   return new LmcTag(this);
+}
+
 //***************************************************************************
 // Update Current Playlist
 //***************************************************************************
@@ -78,57 +124,119 @@ int LmcCom::update(int stateOnly)
 {
    LmcLock;
 
-   const int maxValue = 10000;
-   char* value = 0;
-   int tag;
-
-   LmcTag lt(this);
    char cmd[100];
    int status = success;
    int count = 0;
-   TrackInfo t;
-   int track = no;
    char* buf = 0;
-
-   memset(&playerState, 0, sizeof(playerState));
-   tracks.clear();
+   PlaylistSnapshot* s = new PlaylistSnapshot;   // published (or deleted) by parseStatus()
 
    status += queryInt("playlist tracks", count);
-   query("version", playerState.version,  sizeof(playerState.version));
-   queryInt("mixer muting", playerState.muted);
+   query("version", s->state.version,  sizeof(s->state.version));
+   queryInt("mixer muting", s->state.muted);
 
    if (status != success)
+   {
+      delete s;
       return status;
+   }
 
    if (!stateOnly)
       count = max(count, 100);
 
-   char* param = escape("tags:agdluyKJNxrow");
-   sprintf(cmd, "status 0 %d %s", count, param);
-   free(param);
+   sprintf(cmd, "status 0 %d %s", count, "tags%3AagdluyKJNxrow");   // escaped 'tags:agdluyKJNxrow'
+
+   // CLI: parse the answer while it's arriving
+
+   if (transport == ttCli)
+   {
+      LatencyProbe probe(statOf(cmd));
+      LmcStreamTag lt(this);
+      char* echo = 0;
+
+      request(cmd);
+      asprintf(&echo, "%s %s", escId, lastCommand);
+      status = lt.set(echo);
+      free(echo);
+
+      if (status != success)
+      {
+         tell(eloAlways, "Error: Request of '%s' failed", cmd);
+         delete s;
+         return fail;
+      }
+
+      return parseStatus(&lt, s);
+   }
 
    // perform LMC request ..
 
    LmcDoLock;
-   status = request(cmd);
-   status += write("\n");
-   status += responseP(buf);
+   status = perform(cmd, 0, buf);
    LmcUnLock;
 
    if (status != success)
    {
       tell(eloAlways, "Error: Request of '%s' failed", cmd);
       free(buf);
+      delete s;
       return fail;
    }
 
-   lt.set(buf);
+   LmcTag* lt = newTag();
+
+   if ((status = lt->set(buf)) == success)
+      status = parseStatus(lt, s);
+   else
+      delete s;
+
+   delete lt;
    free(buf);
 
+   return status;
+}
+
+//***************************************************************************
+// Parse Status
+//  - fill player state and track list by the answer of the 'status' query
+//***************************************************************************
+
+int LmcCom::parseStatus(const char* data)
+{
+   LmcLock;
+
+   int status;
+   LmcTag* lt = newTag();
+
+   if (lt->set(data) != success)
+   {
+      delete lt;
+      return fail;
+   }
+
+   status = parseStatus(lt, new PlaylistSnapshot);
+   delete lt;
+
+   return status;
+}
+
+//  - takes the ownership of the snapshot 's' and publishes it
+
+int LmcCom::parseStatus(LmcTag* lt, PlaylistSnapshot* s)
+{
+   const int maxValue = 10000;
+   char* value = 0;
+   int tag;
+   TrackInfo t;
+   int track = no;
+   PlayerState& playerState = s->state;
+   vector<TrackInfo>& tracks = s->tracks;
+
+   tracks.reserve(getSnapshot()->getTrackCount());     // usually the playlist hasn't changed much
+
    t.index = na;
    value = (char*)malloc(maxValue+TB);
 
-   while (lt.getNext(tag, value, maxValue, track) != LmcTag::wrnEndOfPacket)
+   while (lt->getNext(tag, value, maxValue, track) != LmcTag::wrnEndOfPacket)
    {
       switch (tag)
       {
@@ -142,17 +250,21 @@ int LmcCom::update(int stateOnly)
 
          // playlist tags ...
 
-         case LmcTag::tPlaylistIndex:
+         case LmcTag::tLoopItem:       // JSON-RPC, start of the next 'playlist_loop' element
+         case LmcTag::tPlaylistIndex:  // CLI, the index is the first tag of each track
          {
-            if (t.index != na)
+            if (t.index != na && (tag == LmcTag::tLoopItem || !lt->marksItems()))
             {
                t.updatedAt = cTimeMs::Now();
                tracks.push_back(t);
                memset(&t, 0, sizeof(t));
+
+               if (trackListener)
+                  trackListener->tracksArrived(s);
             }
 
             track = yes;
-            t.index = atoi(value);
+            t.index = tag == LmcTag::tLoopItem ? (int)tracks.size() : atoi(value);
             break;
          }
 
@@ -177,6 +289,16 @@ int LmcCom::update(int stateOnly)
 
    free(value);
 
+   // a truncated answer keeps the former snapshot
+
+   if (lt->isTruncated())
+   {
+      tell(eloAlways, "Error: Status answer truncated after %d tracks, keeping the last state",
+           (int)tracks.size());
+      delete s;
+      return fail;
+   }
+
    if (t.index != na)
    {
       t.updatedAt = cTimeMs::Now();
@@ -186,9 +308,36 @@ int LmcCom::update(int stateOnly)
    playerState.plCount = tracks.size();
    tell(eloDetail, "Playlist updated, got %d track", playerState.plCount);
 
+   publish(s);
+
    return success;
 }
 
+//***************************************************************************
+// Restore
+//  - the snapshot of the state cache, called before the first update()
+//    but maybe while a menu thread already updates
+//***************************************************************************
+
+void LmcCom::restore(PlaylistSnapshot* s)
+{
+   LmcLock;
+
+   publish(s);
+}
+
+//***************************************************************************
+// Publish
+//  - replace the current snapshot, readers still holding the former one
+//    keep it until they release it
+//***************************************************************************
+
+void LmcCom::publish(PlaylistSnapshot* s)
+{
+   s->version = ++snapshotVersion;
+   std::atomic_store(&snapshot, SnapshotPtr(s));
+}
+
 //***************************************************************************
 // Query
 //***************************************************************************
@@ -200,8 +349,34 @@ int LmcCom::query(const char* command, char* result, int max)
    int status;
 
    setQueryTitle(command);
-   status = request(command);
-   status += write(" ?\n");
+
+   if (transport == ttJsonRpc)
+   {
+      char name[100+TB];
+      char* buf = 0;
+      char* cmd = 0;
+      LmcJsonTag lt(this);
+
+      *result = 0;
+      asprintf(&cmd, "%s ?", command);
+
+      // the answer is a object with one member like {"_volume":"50"}
+
+      if ((status = perform(cmd, 0, buf)) == success && lt.set(buf) == success)
+         lt.getNext(name, result, max);
+
+      if (status != success)
+         tell(eloAlways, "Error: Request of '%s' failed", command);
+
+      free(cmd);
+      free(buf);
+
+      return status;
+   }
+
+   LatencyProbe probe(statOf(command));
+
+   status = request(command, (Parameters*)0, " ?\n");
 
    if ((status += response(result, max)) != success)
        tell(eloAlways, "Error: Request of '%s' failed", command);
@@ -215,12 +390,20 @@ int LmcCom::queryInt(const char* command, int& value)
 {
    LmcLock;
 
-   // LogDuration ld("queryInt", 0);
    int status;
    char result[100+TB];
 
-   status = request(command);
-   status += write(" ?\n");
+   if (transport == ttJsonRpc)
+   {
+      if ((status = query(command, result, 100)) == success)
+         value = atol(result);
+
+      return status;
+   }
+
+   LatencyProbe probe(statOf(command));
+
+   status = request(command, (Parameters*)0, " ?\n");
    status += response(result, 100);
 
    unescape(result);
@@ -236,8 +419,56 @@ int LmcCom::queryInt(const char* command, int& value)
 //***************************************************************************
 
 int LmcCom::queryRange(RangeQueryType queryType, int from, int count,
-                       RangeList* list, int& total, const char* special, Parameters* pars)
+                       RangeList* list, int& total, const char* special, Parameters* pars,
+                       int useCache)
 {
+   // the library doesn't change until a rescan, answer from the cache
+   //  without waiting for the connection
+
+   std::string cacheKey;
+   std::string radioKey;
+
+   if (RangeCache::isCacheable(queryType))
+   {
+      static EventCounter* hits = Statistics::getCounter("menu.cacheHits");
+      static EventCounter* misses = Statistics::getCounter("menu.cacheMisses");
+
+      cacheKey = RangeCache::toKey(queryType, from, count, pars);
+
+      if (useCache && RangeCache::get(cacheKey, list, total) == success)
+      {
+         hits->add();
+         return success;
+      }
+
+      misses->add();
+   }
+
+   // radios even if stale, the refresher queries them again in the background
+
+   else if (RadioCache::isCacheable(queryType))
+   {
+      RadioCache::Request request = { queryType, from, count, special ? special : "",
+                                      pars ? *pars : Parameters() };
+
+      radioKey = RadioCache::toKey(queryType, from, count, special, pars);
+      request.key = radioKey;
+
+      if (useCache)
+      {
+         static EventCounter* hits = Statistics::getCounter("menu.radioCacheHits");
+         static EventCounter* misses = Statistics::getCounter("menu.radioCacheMisses");
+
+         if (RadioCache::get(radioKey, list, total, &request) == success)
+         {
+            hits->add();
+            return success;
+         }
+
+         misses->add();
+      }
+   }
+
    LmcLock;
 
    char query[200] = "";
@@ -247,18 +478,21 @@ int LmcCom::queryRange(RangeQueryType queryType, int from, int count,
    char value[maxValue+TB];
    int tag;
    char* result = 0;
-   LmcTag lt(this);
+   LmcTag* lt = 0;
    int status;
    ListItem item;
    int firstTag = LmcTag::tId;
+   int scanning = no;
+   Parameters all;
+   const char* tags = 0;
 
    list->clear();
 
    switch (queryType)
    {
-      case rqtGenres:    sprintf(query, "genres");          break;
-      case rqtArtists:   sprintf(query, "artists");         break;
-      case rqtAlbums:    sprintf(query, "albums");          break;
+      case rqtGenres:    sprintf(query, "genres");  tags = "tags:s";  break;
+      case rqtArtists:   sprintf(query, "artists"); tags = "tags:s";  break;
+      case rqtAlbums:    sprintf(query, "albums");  tags = "tags:ls"; break;
       case rqtNewMusic:  sprintf(query, "albums");          break;
       case rqtTracks:    sprintf(query, "tracks");          break;
       case rqtPlaylists: sprintf(query, "playlists");       break;
@@ -284,23 +518,34 @@ int LmcCom::queryRange(RangeQueryType queryType, int from, int count,
 
    setQueryTitle(query);
 
+   // the text key for the jump index of the menu
+
+   if (pars)
+      all = *pars;
+
+   if (tags)
+      all.push_back(tags);
+
    snprintf(cmd, 200, "%s %d %d", query, from, count);
-   status = request(cmd, pars);
-   status += write("\n");
+   status = perform(cmd, &all, result);
    total = 0;
 
-   if ((status += responseP(result)) != success || isEmpty(result))
+   if (status != success || isEmpty(result))
    {
       free(result);
       tell(eloAlways, "Error: Request of '%s' failed", cmd);
       return status;
    }
 
-   lt.set(result);
-   tell(eloDebug, "Got [%s]", unescape(result));
+   lt = newTag();
+   lt->set(result);
+
+   if (loglevel >= eloDebug)
+      tell(eloDebug, "Got [%s]", transport == ttJsonRpc ? result : unescape(result));
+
    free(result); result = 0;
 
-   while (lt.getNext(tag, value, maxValue) != LmcTag::wrnEndOfPacket)
+   while (lt->getNext(tag, value, maxValue) != LmcTag::wrnEndOfPacket)
    {
       if (tag == LmcTag::tItemCount)
       {
@@ -308,10 +553,24 @@ int LmcCom::queryRange(RangeQueryType queryType, int from, int count,
          continue;
       }
 
-      if (tag == firstTag && !item.isEmpty())
+      if (tag == LmcTag::rRescan)
       {
-         list->push_back(item);
-         item.clear();
+         scanning = atoi(value);        // result may be incomplete
+         continue;
+      }
+
+      // JSON-RPC reports each loop element, the CLI starts items with 'firstTag'
+
+      if (tag == LmcTag::tLoopItem || (tag == firstTag && !lt->marksItems()))
+      {
+         if (!item.isEmpty())
+         {
+            list->push_back(item);
+            item.clear();
+         }
+
+         if (tag == LmcTag::tLoopItem)
+            continue;
       }
 
       if (tag == LmcTag::tId)
@@ -320,6 +579,12 @@ int LmcCom::queryRange(RangeQueryType queryType, int from, int count,
          continue;
       }
 
+      if (tag == LmcTag::tTextKey)
+      {
+         item.textKey = value;
+         continue;
+      }
+
       switch (queryType)
       {
          case rqtGenres:
@@ -384,123 +649,429 @@ int LmcCom::queryRange(RangeQueryType queryType, int from, int count,
       };
    }
 
+   delete lt;
+
    if (!item.isEmpty())
    {
       list->push_back(item);
       item.clear();
    }
 
-   // #TODO list->sort();
+   if (!cacheKey.empty() && !scanning)
+      RangeCache::put(cacheKey, list, total);
+
+   if (!radioKey.empty())
+      RadioCache::put(radioKey, list, total);
 
    return success;
 }
 
 //***************************************************************************
-// Execute
+// Query Library
+//  - one page of all tracks of the library with the ids and names of
+//    album, artist and genre, used to build the local library index
 //***************************************************************************
 
-int LmcCom::execute(const char* command, Parameters* pars)
+int LmcCom::queryLibrary(int from, int count, LibraryTracks* tracks, int& total)
 {
    LmcLock;
 
-   tell(eloDetail, "Exectuting '%s' with %d parameters", command, pars ? pars->size() : 0);
-   request(command, pars);
-   write("\n");
+   const int maxValue = 500;
+   char value[maxValue+TB];
+   char cmd[100];
+   char* result = 0;
+   int tag;
+   int status;
+   LmcTag* lt = 0;
+   LibraryTrack track;
+   Parameters pars;
 
-   return response();
-}
+   tracks->clear();
+   total = 0;
 
-int LmcCom::execute(const char* command, const char* par)
-{
-   LmcLock;
+   snprintf(cmd, 100, "tracks %d %d", from, count);
+   pars.push_back("tags:aeglpstyJ");
 
-   tell(eloDetail, "Exectuting '%s' with '%s'", command, par);
-   request(command, par);
-   write("\n");
+   status = perform(cmd, &pars, result);
 
-   return response();
-}
+   if (status != success || isEmpty(result))
+   {
+      free(result);
+      tell(eloAlways, "Error: Request of '%s' failed", cmd);
+      return fail;
+   }
 
-int LmcCom::execute(const char* command, int par)
-{
-   LmcLock;
-   char str[10];
+   lt = newTag();
+   lt->set(result);
+   free(result);
 
-   sprintf(str, "%d", par);
+   while (lt->getNext(tag, value, maxValue) != LmcTag::wrnEndOfPacket)
+   {
+      // JSON-RPC reports each loop element, the CLI starts the tracks with the id
 
-   return execute(command, str);
-}
+      if (tag == LmcTag::tLoopItem || (tag == LmcTag::tId && !lt->marksItems()))
+      {
+         if (track.id)
+            tracks->push_back(track);
 
-//***************************************************************************
-// Request
-//***************************************************************************
+         track.clear();
 
-int LmcCom::request(const char* command, const char* par)
-{
-   Parameters pars;
+         if (tag == LmcTag::tLoopItem)
+            continue;
+      }
 
-   pars.push_back(par);
+      switch (tag)
+      {
+         case LmcTag::tItemCount:       total = atoi(value);          break;
+         case LmcTag::tId:              track.id = atoi(value);       break;
+         case LmcTag::tTitle:           track.title = value;          break;
+         case LmcTag::tAlbumId:         track.albumId = atoi(value);  break;
+         case LmcTag::tAlbum:           track.album = value;          break;
+         case LmcTag::tArtistId:        track.artistId = atoi(value); break;
+         case LmcTag::tArtist:          track.artist = value;         break;
+         case LmcTag::tGenreId:         track.genreId = atoi(value);  break;
+         case LmcTag::tGenre:           track.genre = value;          break;
+         case LmcTag::tYear:            track.year = atoi(value);     break;
+         case LmcTag::tTrackNum:        track.trackNum = atoi(value); break;
+         case LmcTag::tArtworkTrackId:  track.artwork = value;        break;
+
+         default: break;
+      }
+   }
+
+   delete lt;
+
+   if (track.id)
+      tracks->push_back(track);
 
-   return request(command, &pars);
+   return success;
 }
 
 //***************************************************************************
-// Request
+// Search
+//  - LMS search of artists (contributors), albums and tracks, the items
+//    get the filter tag of their type as command (like artist_id)
 //***************************************************************************
 
-int LmcCom::request(const char* command, Parameters* pars)
+int LmcCom::search(const char* term, int max, RangeList* list)
 {
-   int status;
+   LmcLock;
 
-   snprintf(lastCommand, sizeMaxCommand, "%s", command);
+   const int maxValue = 500;
+   char name[100+TB];
+   char value[maxValue+TB];
+   char cmd[100];
+   char* result = 0;
+   LmcTag* lt = 0;
+   ListItem item;
+   Parameters pars;
 
-   lastPar = "";
+   list->clear();
 
-   if (pars)
+   snprintf(cmd, 100, "search 0 %d", max);
+   pars.push_back(std::string("term:") + term);
+
+   if (perform(cmd, &pars, result) != success)
    {
-      LmcCom::Parameters::iterator it;
+      free(result);
+      tell(eloAlways, "Error: Request of '%s' failed", cmd);
+      return fail;
+   }
 
-      for (it = pars->begin(); it != pars->end(); ++it)
+   lt = newTag();
+   lt->set(result ? result : "");
+   free(result);
+
+   while (lt->getNext(name, value, maxValue) != LmcTag::wrnEndOfPacket)
+   {
+      const char* type = 0;
+
+      // each result starts with its id
+
+      if (strcmp(name, "contributor_id") == 0)  type = "artist_id";
+      else if (strcmp(name, "album_id") == 0)   type = "album_id";
+      else if (strcmp(name, "track_id") == 0)   type = "track_id";
+
+      if (type)
       {
-         char* p = escape((*it).c_str());
-         lastPar += std::string(p) + " ";
-         free(p);
+         if (!item.isEmpty())
+            list->push_back(item);
+
+         item.clear();
+         item.id = value;
+         item.command = type;
+         item.hasItems = strcmp(type, "track_id") != 0;
+         item.isAudio = yes;
+
+         continue;
       }
-   }
 
-   tell(eloDebug, "Requesting '%s' with '%s'", lastCommand, lastPar.c_str());
-   flush();
+      if (!item.command.empty() && (strcmp(name, "contributor") == 0
+                                    || strcmp(name, "album") == 0 || strcmp(name, "track") == 0))
+         item.content = value;
+   }
 
-   status = write(escId)
-      + write(" ")
-      + write(lastCommand);
+   delete lt;
 
-   if (lastPar != "")
-      status += write(" ")
-         + write(lastPar.c_str());
+   if (!item.isEmpty())
+      list->push_back(item);
 
-   return status;
+   return success;
 }
 
 //***************************************************************************
-// Response
+// Query Server Status
+//  - time of the last library scan and if a scan is running
 //***************************************************************************
 
-int LmcCom::responseP(char*& result)
+int LmcCom::queryServerStatus(long& lastScan, int& scanning)
 {
-   // LogDuration ld("response", 0);
-
-   int status = fail;
-   char* buf = 0;
+   LmcLock;
 
-   result = 0;
+   char name[100+TB];
+   char value[100+TB];
+   char* result = 0;
+   LmcTag* lt = 0;
 
-   // wait op to 30 seconds to receive answer ..
+   lastScan = 0;
+   scanning = no;
 
-   if (look(30000) == success && (buf = readln()))
+   if (perform("serverstatus 0 0", 0, result) != success || isEmpty(result))
    {
-      char* p = buf + strlen(escId) +1;
-
+      free(result);
+      tell(eloAlways, "Error: Request of 'serverstatus' failed");
+      return fail;
+   }
+
+   lt = newTag();
+   lt->set(result);
+   free(result);
+
+   while (lt->getNext(name, value, 100) != LmcTag::wrnEndOfPacket)
+   {
+      if (strcmp(name, "lastscan") == 0)
+         lastScan = atol(value);
+      else if (strcmp(name, "rescan") == 0)
+         scanning = atoi(value);
+   }
+
+   delete lt;
+
+   if (lastScan)
+      RangeCache::setLastScan(lastScan);
+
+   return success;
+}
+
+//***************************************************************************
+// Execute
+//***************************************************************************
+
+int LmcCom::execute(const char* command, Parameters* pars)
+{
+   LmcLock;
+
+   tell(eloDetail, "Exectuting '%s' with %d parameters", command, pars ? pars->size() : 0);
+
+   if (transport == ttJsonRpc)
+   {
+      char* result = 0;
+      int status = perform(command, pars, result);
+
+      free(result);
+      return status;
+   }
+
+   LatencyProbe probe(statOf(command));
+
+   request(command, pars);
+
+   return response();
+}
+
+int LmcCom::execute(const char* command, const char* par)
+{
+   LmcLock;
+
+   tell(eloDetail, "Exectuting '%s' with '%s'", command, par);
+
+   if (transport == ttJsonRpc)
+   {
+      Parameters pars;
+
+      pars.push_back(par);
+
+      return execute(command, &pars);
+   }
+
+   LatencyProbe probe(statOf(command));
+
+   request(command, par);
+
+   return response();
+}
+
+int LmcCom::execute(const char* command, int par)
+{
+   LmcLock;
+   char str[10];
+
+   sprintf(str, "%d", par);
+
+   return execute(command, str);
+}
+
+//***************************************************************************
+// Perform
+//  - send request and receive the answer by the selected transport
+//***************************************************************************
+
+int LmcCom::perform(const char* command, Parameters* pars, char*& result)
+{
+   LatencyProbe probe(statOf(command));
+   int status;
+
+   result = 0;
+
+   if (transport == ttJsonRpc)
+      return jsonCall(command, pars, result);
+
+   status = request(command, pars);
+   status += responseP(result);
+
+   return status;
+}
+
+//***************************************************************************
+// Statistic of Command
+//  - one latency statistic per command type like 'lms.status' or
+//    'lms.playlist index'
+//***************************************************************************
+
+LatencyStat* LmcCom::statOf(const char* command)
+{
+   char name[LatencyStat::sizeName+TB];
+   int len = strcspn(command, " ");
+
+   // playlist and mixer are groups of commands, take the second word as well
+
+   if ((strncmp(command, "playlist ", 9) == 0 || strncmp(command, "mixer ", 6) == 0) && command[len])
+      len += 1 + strcspn(command+len+1, " ");
+
+   snprintf(name, sizeof(name), "lms.%.*s", len, command);
+
+   return Statistics::get(name);
+}
+
+//***************************************************************************
+// JSON-RPC Call
+//  - the command may contain escaped tokens (like the CLI request),
+//    the parameters are passed unescaped
+//***************************************************************************
+
+int LmcCom::jsonCall(const char* command, Parameters* pars, char*& result)
+{
+   Parameters tokens;
+   char* cmd = strdup(command);
+   char* save = 0;
+
+   snprintf(lastCommand, sizeMaxCommand, "%s", command);
+
+   for (char* p = strtok_r(cmd, " ", &save); p; p = strtok_r(0, " ", &save))
+      tokens.push_back(unescape(p));
+
+   free(cmd);
+
+   if (pars)
+      tokens.insert(tokens.end(), pars->begin(), pars->end());
+
+   tell(eloDebug, "Requesting '%s' with %d parameters (JSON-RPC)", lastCommand, pars ? pars->size() : 0);
+
+   return json->call(mac ? mac : "", &tokens, result);
+}
+
+//***************************************************************************
+// Request
+//***************************************************************************
+
+int LmcCom::request(const char* command, const char* par, const char* term)
+{
+   Parameters pars;
+
+   pars.push_back(par);
+
+   return request(command, &pars, term);
+}
+
+//***************************************************************************
+// Request
+//  - the whole line (including the terminator like "\n" or " ?\n") is
+//    sent by one writev(), no small segments waiting for delayed ACKs
+//***************************************************************************
+
+int LmcCom::request(const char* command, Parameters* pars, const char* term)
+{
+   struct iovec iov[6];
+   int count = 0;
+
+   snprintf(lastCommand, sizeMaxCommand, "%s", command);
+
+   lastPar = "";
+
+   if (pars)
+   {
+      LmcCom::Parameters::iterator it;
+
+      // escape directly into lastPar, it keeps its capacity from request to request
+
+      for (it = pars->begin(); it != pars->end(); ++it)
+      {
+         size_t pos = lastPar.length();
+         int max = 3 * it->length() + TB;
+
+         lastPar.resize(pos + max);
+         lastPar.resize(pos + urlEscape(&lastPar[pos], max, it->c_str()));
+         lastPar += ' ';
+      }
+   }
+
+   tell(eloDebug, "Requesting '%s' with '%s'", lastCommand, lastPar.c_str());
+   flush();
+
+   iov[count].iov_base = escId;             iov[count++].iov_len = strlen(escId);
+   iov[count].iov_base = (void*)" ";        iov[count++].iov_len = 1;
+   iov[count].iov_base = lastCommand;       iov[count++].iov_len = strlen(lastCommand);
+
+   if (lastPar != "")
+   {
+      iov[count].iov_base = (void*)" ";                iov[count++].iov_len = 1;
+      iov[count].iov_base = (void*)lastPar.c_str();    iov[count++].iov_len = lastPar.length();
+   }
+
+   iov[count].iov_base = (void*)term;       iov[count++].iov_len = strlen(term);
+
+   return writev(iov, count);
+}
+
+//***************************************************************************
+// Response
+//***************************************************************************
+
+int LmcCom::responseP(char*& result)
+{
+   // LogDuration ld("response", 0);
+
+   int status = fail;
+   char* buf = 0;
+
+   result = 0;
+
+   // wait op to 30 seconds to receive answer ..
+
+   if (look(30000) == success && (buf = readln()))
+   {
+      char* p = buf + strlen(escId) +1;
+
       if ((p = strstr(p, lastCommand)) && strlen(p) >= strlen(lastCommand))
       {
          p += strlen(lastCommand);
@@ -583,24 +1154,15 @@ int LmcCom::response(char* result, int max)
 
 char* LmcCom::unescape(char* buf)
 {
-   int len = 0;
-   char* res;
-
-   res = curl_easy_unescape(curl , buf, strlen(buf), &len);
-
-   if (res)
-      strcpy(buf, res);
-
-   free(res);
-
-   return buf;
+   return urlUnescape(buf);
 }
 
 char* LmcCom::escape(const char* buf)
 {
-   char* res;
+   int max = 3 * strlen(buf) + TB;
+   char* res = (char*)malloc(max);
 
-   res = curl_easy_escape(curl , buf, strlen(buf));
+   urlEscape(res, max, buf);
 
    return res;
 }
@@ -611,6 +1173,9 @@ char* LmcCom::escape(const char* buf)
 
 int LmcCom::startNotify()
 {
+   if (notify)
+      return done;        // already listening (LMC manager or OSD)
+
    notify = new LmcCom(mac);
 
    if (notify->open(host, port) != success)
@@ -638,13 +1203,16 @@ int LmcCom::stopNotify()
 
 //***************************************************************************
 // Check for Notification
+//  - success if the player state changed, updated already if 'withUpdate'
+//  - fail if the notification channel is lost (LMS restarted), the
+//    caller has to stopNotify() and subscribe again
 //***************************************************************************
 
-int LmcCom::checkNotify(uint64_t timeout)
+int LmcCom::checkNotify(uint64_t timeout, int withUpdate)
 {
-   // LogDuration ld("checkNotify", 0);
    char buf[1000+TB];
    int status = wrnNoEventPending;
+   int res;
 
    metaDataChanged = no;
 
@@ -654,9 +1222,9 @@ int LmcCom::checkNotify(uint64_t timeout)
       return fail;
    }
 
-   while (notify->look(timeout) == success)
+   while ((res = notify->look(timeout)) == success)
    {
-      if (notify->read(buf, 1000, yes) == success)
+      if ((res = notify->read(buf, 1000, yes)) == success)
       {
          buf[strlen(buf)-1] = 0;   // cut LF
 
@@ -664,6 +1232,15 @@ int LmcCom::checkNotify(uint64_t timeout)
 
          tell(eloDebug, "<- [%s]", buf);
 
+         if (status != success)
+            notifiedAt = Statistics::usNow();
+
+         if (strncmp(buf, "rescan", 6) == 0 || strstr(buf, " rescan ") || strstr(buf, "playlists "))
+         {
+            tell(eloDetail, "Library changed, clearing the menu cache");
+            RangeCache::clear();
+         }
+
          if (strstr(buf, "playlist "))
             status = success;
          else if (strstr(buf, "pause ") || strstr(buf, "server"))
@@ -674,10 +1251,22 @@ int LmcCom::checkNotify(uint64_t timeout)
             status = success;
          }
       }
+      else if (res != TcpChannel::wrnTimeout)
+         break;
    }
 
-   if (status == success)
+   if (res != success && res != TcpChannel::wrnNoEventPending && res != TcpChannel::wrnTimeout)
+   {
+      tell(eloAlways, "Error: Notification channel lost (%d)", res);
+      return fail;
+   }
+
+   if (status == success && withUpdate)
+   {
+      static LatencyStat* stat = Statistics::get("notify.update");
+      LatencyProbe probe(stat);
       update();
+   }
 
    return status;
 }
@@ -686,7 +1275,7 @@ int LmcCom::checkNotify(uint64_t timeout)
 // Get Current Cover
 //***************************************************************************
 
-int LmcCom::getCurrentCover(MemoryStruct* cover, TrackInfo* track)
+int LmcCom::getCurrentCover(MemoryStruct* cover, const TrackInfo* track)
 {
    char* url = 0;
    int status = fail;
@@ -694,21 +1283,27 @@ int LmcCom::getCurrentCover(MemoryStruct* cover, TrackInfo* track)
    if (track && !isEmpty(track->artworkurl))
    {
       asprintf(&url, "http://%s:%d/%s",
-               host, 9000, track->artworkurl);
+               host, httpPort, track->artworkurl);
 
-      status = downloadFile(url, cover);
+      status = downloadCover(url, cover);
 
       free(url);
    }
 
+   // local tracks have a stable cover url, same as in getCover() and
+   //  maybe already prefetched
+
+   if (status != success && track && track->id > 0)
+      status = getCover(cover, track);
+
    if (status != success)
    {
       // http://localhost:9000/music/current/cover.jpg?player=f0:4d:a2:33:b7:ed
 
       asprintf(&url, "http://%s:%d/music/current/cover.jpg?player=%s",
-               host, 9000, escId);
+               host, httpPort, escId);
 
-      status = downloadFile(url, cover);
+      status = downloadCover(url, cover, no);
 
       free(url);
    }
@@ -720,15 +1315,15 @@ int LmcCom::getCurrentCover(MemoryStruct* cover, TrackInfo* track)
 // Get Cover
 //***************************************************************************
 
-int LmcCom::getCover(MemoryStruct* cover, TrackInfo* track)
+int LmcCom::getCover(MemoryStruct* cover, const TrackInfo* track)
 {
    char* url = 0;
    int status = fail;
 
    if (track && !isEmpty(track->artworkurl))
    {
-      asprintf(&url, "http://%s:%d/%s", host, 9000, track->artworkurl);
-      status = downloadFile(url, cover);
+      asprintf(&url, "http://%s:%d/%s", host, httpPort, track->artworkurl);
+      status = downloadCover(url, cover);
       free(url);
    }
 
@@ -737,13 +1332,530 @@ int LmcCom::getCover(MemoryStruct* cover, TrackInfo* track)
       // http://<server>:<port>/music/<track_id>/cover.jpg
 
       if (isEmpty(track->artworkTrackId))
-         asprintf(&url, "http://%s:%d/music/%d/cover.jpg", host, 9000, track->id);
+         asprintf(&url, "http://%s:%d/music/%d/cover.jpg", host, httpPort, track->id);
       else
-         asprintf(&url, "http://%s:%d/music/%s/cover.jpg", host, 9000, track->artworkTrackId);
+         asprintf(&url, "http://%s:%d/music/%s/cover.jpg", host, httpPort, track->artworkTrackId);
 
-      status = downloadFile(url, cover);
+      status = downloadCover(url, cover);
       free(url);
    }
 
    return status;
 }
+
+//***************************************************************************
+// Collation Key
+//  - strxfrm() of the current locale (LC_COLLATE), a plain strcmp() of two
+//    keys orders like strcoll() of the strings, but the locale is asked
+//    only once per string and not on every comparison
+//***************************************************************************
+
+std::string LmcCom::collationKey(const char* s)
+{
+   char buf[500+TB];
+   size_t len = strxfrm(buf, s, sizeof(buf));
+
+   if (len < sizeof(buf))
+      return std::string(buf, len);
+
+   std::string key(len, 0);
+   strxfrm(&key[0], s, len+1);
+
+   return key;
+}
+
+//***************************************************************************
+// Text Key
+//  - the jump letter of a name like the 'textkey' of the LMS, the first
+//    character (UTF-8) upper case with the accents removed ("\u00c4rzte" -> "A"),
+//    so it orders like the collation key of the name
+//  - characters without a plain latin letter stay as they are
+//***************************************************************************
+
+std::string LmcCom::textKeyOf(const char* s)
+{
+   // base letters of U+00C0 .. U+017F, '.' for none
+
+   static const char* latin =
+      "AAAAAAACEEEEIIII" "DNOOOOO.OUUUUYTS"       // U+00C0
+      "AAAAAAACEEEEIIII" "DNOOOOO.OUUUUYTY"       // U+00E0
+      "AAAAAACCCCCCCCDD" "DDEEEEEEEEEEGGGG"       // U+0100
+      "GGGGHHHHIIIIIIII" "IIIIJJKKKLLLLLLL"       // U+0120
+      "LLLNNNNNNNNNOOOO" "OOOORRRRRRSSSSSS"       // U+0140
+      "SSTTTTTTUUUUUUUU" "UUUUWWYYYZZZZZZS";      // U+0160
+
+   const unsigned char* p = (const unsigned char*)s;
+   unsigned int c;
+   int len;
+
+   if (!*p)
+      return "";
+
+   if (*p < 0x80)
+      return std::string(1, toupper(*p));
+
+   // decode the first code point
+
+   if ((*p & 0xE0) == 0xC0)      { c = *p & 0x1F; len = 2; }
+   else if ((*p & 0xF0) == 0xE0) { c = *p & 0x0F; len = 3; }
+   else if ((*p & 0xF8) == 0xF0) { c = *p & 0x07; len = 4; }
+   else return std::string(1, *p);              // not UTF-8, keep the byte
+
+   for (int i = 1; i < len; i++)
+   {
+      if ((p[i] & 0xC0) != 0x80)
+         return std::string(1, *p);
+
+      c = (c << 6) | (p[i] & 0x3F);
+   }
+
+   if (c >= 0xC0 && c <= 0x17F && latin[c - 0xC0] != '.')
+      return std::string(1, latin[c - 0xC0]);
+
+   return std::string(s, len);
+}
+
+//***************************************************************************
+// Sort List
+//  - by content in the order of the locale, stable (std::list::sort)
+//  - the keys are computed once and stay with the items, merging further
+//    pages (mergeList) needs only the keys of the new page
+//***************************************************************************
+
+void LmcCom::sortList(RangeList* list)
+{
+   for (auto it = list->begin(); it != list->end(); ++it)
+   {
+      if (it->sortKey.empty())
+         it->sortKey = collationKey(it->content.c_str());
+   }
+
+   list->sort([](const ListItem& a, const ListItem& b) { return a.sortKey < b.sortKey; });
+}
+
+void LmcCom::mergeList(RangeList* list, RangeList* page)
+{
+   sortList(page);
+
+   // items of the list win on equal keys, the order stays stable
+
+   list->merge(*page, [](const ListItem& a, const ListItem& b) { return a.sortKey < b.sortKey; });
+}
+
+//***************************************************************************
+// Cover Key
+//  - identifies the cover of a track in the image caches
+//***************************************************************************
+
+std::string LmcCom::coverKey(const TrackInfo* track)
+{
+   if (!isEmpty(track->artworkurl))
+      return track->artworkurl;
+
+   if (!isEmpty(track->artworkTrackId))
+      return track->artworkTrackId;
+
+   return num2Str(track->id);
+}
+
+//***************************************************************************
+// Prefetch Cover
+//  - only fill the cover cache
+//***************************************************************************
+
+int LmcCom::prefetchCover(const TrackInfo* track)
+{
+   MemoryStruct cover;
+
+   return getCover(&cover, track);
+}
+
+//***************************************************************************
+// Download Cover
+//***************************************************************************
+
+int LmcCom::downloadCover(const char* url, MemoryStruct* cover, int cached)
+{
+   int status;
+
+   if (cached && CoverCache::get(url, cover) == success)
+      return success;
+
+   static LatencyStat* stat = Statistics::get("cover.download");
+   LatencyProbe probe(stat);
+
+   status = downloadFile(url, cover);
+
+   if (cached && status == success)
+      CoverCache::put(url, cover);
+
+   return status;
+}
+
+//***************************************************************************
+// Cover Cache
+//***************************************************************************
+
+std::list<std::pair<std::string,std::string>> CoverCache::entries;
+std::mutex CoverCache::mutex;
+
+int CoverCache::get(const char* url, MemoryStruct* cover)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   for (auto it = entries.begin(); it != entries.end(); ++it)
+   {
+      if (it->first == url)
+      {
+         cover->clear();
+         cover->size = it->second.size();
+         cover->memory = (char*)malloc(cover->size);
+         memcpy(cover->memory, it->second.data(), cover->size);
+
+         entries.splice(entries.begin(), entries, it);   // latest first
+
+         return success;
+      }
+   }
+
+   return fail;
+}
+
+void CoverCache::put(const char* url, const MemoryStruct* cover)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   for (auto it = entries.begin(); it != entries.end(); ++it)
+   {
+      if (it->first == url)
+      {
+         entries.erase(it);
+         break;
+      }
+   }
+
+   entries.emplace_front(url, std::string(cover->memory, cover->size));
+
+   if (entries.size() > maxEntries)
+      entries.pop_back();
+}
+
+void CoverCache::clear()
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   entries.clear();
+}
+
+//***************************************************************************
+// Range Cache
+//***************************************************************************
+
+std::list<RangeCache::Entry> RangeCache::entries;
+size_t RangeCache::items = 0;
+long RangeCache::lastScan = 0;
+std::mutex RangeCache::mutex;
+
+int RangeCache::isCacheable(LmcCom::RangeQueryType queryType)
+{
+   // radios, apps and favorites are online content
+
+   switch (queryType)
+   {
+      case LmcCom::rqtGenres:
+      case LmcCom::rqtArtists:
+      case LmcCom::rqtAlbums:
+      case LmcCom::rqtNewMusic:
+      case LmcCom::rqtTracks:
+      case LmcCom::rqtYears:
+      case LmcCom::rqtPlaylists: return yes;
+
+      default: return no;
+   }
+}
+
+std::string RangeCache::toKey(LmcCom::RangeQueryType queryType, int from, int count,
+                              LmcCom::Parameters* pars)
+{
+   char buf[50];
+
+   snprintf(buf, sizeof(buf), "%d:%d:%d", queryType, from, count);
+
+   std::string key = buf;
+
+   if (pars)
+   {
+      for (auto it = pars->begin(); it != pars->end(); ++it)
+         key += "|" + *it;
+   }
+
+   return key;
+}
+
+int RangeCache::get(const std::string& key, LmcCom::RangeList* list, int& total)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   for (auto it = entries.begin(); it != entries.end(); ++it)
+   {
+      if (it->key == key)
+      {
+         *list = it->list;
+         total = it->total;
+
+         entries.splice(entries.begin(), entries, it);   // latest first
+
+         return success;
+      }
+   }
+
+   return fail;
+}
+
+void RangeCache::put(const std::string& key, const LmcCom::RangeList* list, int total)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   for (auto it = entries.begin(); it != entries.end(); ++it)
+   {
+      if (it->key == key)
+      {
+         items -= it->list.size();
+         entries.erase(it);
+         break;
+      }
+   }
+
+   if (list->size() > maxItems)
+      return;
+
+   entries.push_front(Entry());
+   entries.front().key = key;
+   entries.front().list = *list;
+   entries.front().total = total;
+   items += list->size();
+
+   while (items > maxItems)
+   {
+      items -= entries.back().list.size();
+      entries.pop_back();
+   }
+}
+
+void RangeCache::clear()
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   entries.clear();
+   items = 0;
+}
+
+void RangeCache::setLastScan(long aLastScan)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   if (aLastScan == lastScan)
+      return;
+
+   if (lastScan && entries.size())
+   {
+      tell(eloDetail, "Library rescanned (lastscan %ld), clearing the menu cache", aLastScan);
+      entries.clear();
+      items = 0;
+   }
+
+   lastScan = aLastScan;
+}
+
+//***************************************************************************
+// Radio Cache
+//***************************************************************************
+
+std::list<RadioCache::Entry> RadioCache::entries;
+std::list<RadioCache::Request> RadioCache::requests;
+size_t RadioCache::items = 0;
+std::mutex RadioCache::mutex;
+int RadioCache::ttl = 0;
+void (*RadioCache::notify)() = 0;
+
+int RadioCache::isCacheable(LmcCom::RangeQueryType queryType)
+{
+   return ttl > 0 && (queryType == LmcCom::rqtRadios || queryType == LmcCom::rqtRadioApps);
+}
+
+std::string RadioCache::toKey(LmcCom::RangeQueryType queryType, int from, int count,
+                              const char* special, LmcCom::Parameters* pars)
+{
+   std::string key = RangeCache::toKey(queryType, from, count, pars);
+
+   if (!isEmpty(special))
+      key += std::string("|") + special;
+
+   return key;
+}
+
+int RadioCache::get(const std::string& key, LmcCom::RangeList* list, int& total, const Request* request)
+{
+   void (*wakeup)() = 0;
+   int status = fail;
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      for (auto it = entries.begin(); it != entries.end(); ++it)
+      {
+         if (it->key == key)
+         {
+            *list = it->list;
+            total = it->total;
+
+            if (it->stored + ttl < time(0) && !it->refreshing)
+            {
+               it->refreshing = yes;
+
+               if (queue(request))
+                  wakeup = notify;
+            }
+
+            entries.splice(entries.begin(), entries, it);   // latest first
+            status = success;
+            break;
+         }
+      }
+   }
+
+   signal(wakeup);
+
+   return status;
+}
+
+void RadioCache::put(const std::string& key, const LmcCom::RangeList* list, int total)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   for (auto it = entries.begin(); it != entries.end(); ++it)
+   {
+      if (it->key == key)
+      {
+         items -= it->list.size();
+         entries.erase(it);
+         break;
+      }
+   }
+
+   if (list->size() > maxItems)
+      return;
+
+   entries.push_front(Entry());
+   entries.front().key = key;
+   entries.front().list = *list;
+   entries.front().total = total;
+   entries.front().stored = time(0);
+   entries.front().refreshing = no;
+   items += list->size();
+
+   while (items > maxItems)
+   {
+      items -= entries.back().list.size();
+      entries.pop_back();
+   }
+}
+
+void RadioCache::clear()
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   entries.clear();
+   requests.clear();
+   items = 0;
+}
+
+//***************************************************************************
+// Requests
+//***************************************************************************
+
+void RadioCache::setNotify(void (*aNotify)())
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   notify = aNotify;
+}
+
+int RadioCache::prefetch(const Request* request)
+{
+   if (!isCacheable(request->queryType))
+      return done;
+
+   void (*wakeup)() = 0;
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      for (auto it = entries.begin(); it != entries.end(); ++it)
+      {
+         if (it->key == request->key)
+            return done;                // a stale one is queued by get()
+      }
+
+      if (queue(request))
+         wakeup = notify;
+   }
+
+   signal(wakeup);
+
+   return success;
+}
+
+int RadioCache::queue(const Request* request)
+{
+   for (auto it = requests.begin(); it != requests.end(); ++it)
+   {
+      if (it->key == request->key)
+         return no;
+   }
+
+   requests.push_back(*request);
+
+   return yes;
+}
+
+//***************************************************************************
+// Signal
+//  - wakes the refresher after the mutex is released, it takes the
+//    request with the same mutex
+//***************************************************************************
+
+void RadioCache::signal(void (*wakeup)())
+{
+   if (wakeup)
+      wakeup();
+}
+
+int RadioCache::takeRequest(Request& request)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   if (requests.empty())
+      return fail;
+
+   request = requests.front();
+   requests.pop_front();
+
+   return success;
+}
+
+void RadioCache::refreshDone(const std::string& key)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   // after a failed query, the next get() may queue it again
+
+   for (auto it = entries.begin(); it != entries.end(); ++it)
+   {
+      if (it->key == key)
+      {
+         it->refreshing = no;
+         break;
+      }
+   }
+}
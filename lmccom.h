@@ -8,10 +8,11 @@
 #ifndef __LMCCOM_H
 #define __LMCCOM_H
 
-#include <curl/curl.h>
 #include <vector>
 #include <list>
 #include <string>
+#include <memory>
+#include <mutex>
 
 using std::vector;
 
@@ -29,6 +30,69 @@ using std::vector;
 #  define LmcUnLock
 #endif
 
+class LmcTag;
+class LmcJsonRpc;
+class LatencyStat;
+
+//***************************************************************************
+// Playlist Snapshot
+//  - player state and track list of one 'status' answer, build by
+//    update() and immutable once published, readers keep the shared_ptr
+//    as long as they use it and never see a half build state
+//***************************************************************************
+
+struct PlaylistSnapshot
+{
+   PlaylistSnapshot() { version = 0; first = 0; restored = no; }
+
+   int getTrackCount() const               { return first + tracks.size(); }
+   const TrackInfo* getTrack(int idx) const
+   {
+      static const TrackInfo dummyTrack;
+
+      if (idx < first || idx - first >= (int)tracks.size())
+         return &dummyTrack;            // outside of a restored window
+
+      return &tracks[idx - first];
+   }
+
+   const TrackInfo* getCurrentTrack() const { return getTrack(state.plIndex); }
+
+   uint64_t version;               // incremented with each published snapshot
+   int first;                      // playlist index of tracks[0], > 0 only for a restored window
+   int restored;                   // loaded from the state cache, not yet confirmed by the LMS
+   PlayerState state;
+   vector<TrackInfo> tracks;
+};
+
+typedef std::shared_ptr<const PlaylistSnapshot> SnapshotPtr;
+
+//***************************************************************************
+// Cover Cache
+//  - process wide, the downloaded covers by url, oldest dropped first
+//  - filled by the prefetch of the LMC manager and the OSD, the
+//    current cover of streams (music/current) isn't cached
+//***************************************************************************
+
+class CoverCache
+{
+   public:
+
+      enum Misc
+      {
+         maxEntries = 50
+      };
+
+      static int get(const char* url, MemoryStruct* cover);
+      static void put(const char* url, const MemoryStruct* cover);
+      static void clear();
+
+   private:
+
+      static std::list<std::pair<std::string,std::string>> entries;   // url, data (latest first)
+      static std::mutex mutex;
+};
+
 //***************************************************************************
 // LMC Communication
 //***************************************************************************
@@ -53,15 +117,29 @@ class LmcCom : public TcpChannel
          rqtFavorites
       };
 
+      // informed while the tracks of the 'status' answer arrive
+
+      class TrackListener
+      {
+         public:
+
+            virtual ~TrackListener() {}
+            // the snapshot isn't published yet, only valid during the call
+
+            virtual void tracksArrived(const PlaylistSnapshot* building) = 0;
+      };
+
       struct ListItem
       {
          ListItem()     { clear(); }
-         void clear()   { id = ""; content = ""; command = ""; hasItems = no; isAudio = no; }
+         void clear()   { id = ""; content = ""; command = ""; textKey = ""; sortKey = ""; hasItems = no; isAudio = no; }
          int isEmpty()  { return content == ""; }
 
          std::string id;
          std::string content;
          std::string command;
+         std::string textKey;     // first letter (sort order), genres, artists and albums only
+         std::string sortKey;     // collation key of the content, set by sortList()
          int hasItems;
          int isAudio;
       };
@@ -69,6 +147,33 @@ class LmcCom : public TcpChannel
       typedef std::list<ListItem> RangeList;
       typedef std::list<std::string> Parameters;
 
+      struct LibraryTrack
+      {
+         LibraryTrack()  { clear(); }
+         void clear()    { id = albumId = artistId = genreId = year = trackNum = 0;
+                           title = album = artist = genre = artwork = ""; }
+
+         int id;
+         int albumId;
+         int artistId;
+         int genreId;
+         int year;
+         int trackNum;
+         std::string title;
+         std::string album;
+         std::string artist;
+         std::string genre;
+         std::string artwork;     // artwork_track_id
+      };
+
+      typedef std::vector<LibraryTrack> LibraryTracks;
+
+      enum Transport
+      {
+         ttCli,              // telnet like CLI protocol (lmcPort)
+         ttJsonRpc           // JSON-RPC over keep-alive HTTP (lmcHttpPort)
+      };
+
       enum Misc
       {
          sizeMaxCommand = 100
@@ -93,6 +198,8 @@ class LmcCom : public TcpChannel
       }
 
       int open(const char* host = "localhost", unsigned short port = 9090);
+      void setTransport(int aTransport, unsigned short aHttpPort = 9000);
+      int getTransport() { return transport; }
 
       int execute(const char* command, Parameters* pars = 0);
       int execute(const char* command, int par);
@@ -102,19 +209,38 @@ class LmcCom : public TcpChannel
       int queryInt(const char* command, int& value);
 
       int queryRange(RangeQueryType queryType, int from, int count,
-                     RangeList* list, int& total, const char* special = "", Parameters* pars = 0);
+                     RangeList* list, int& total, const char* special = "", Parameters* pars = 0,
+                     int useCache = yes);
+      int queryLibrary(int from, int count, LibraryTracks* tracks, int& total);
+      int queryServerStatus(long& lastScan, int& scanning);
+      int search(const char* term, int max, RangeList* list);
+
+      static std::string collationKey(const char* s);
+      static std::string textKeyOf(const char* s);
+      static int compareTextKeys(const char* a, const char* b) { return strcoll(a, b); }
+
+      struct TextKeyLess
+      {
+         bool operator()(const std::string& a, const std::string& b) const
+         { return compareTextKeys(a.c_str(), b.c_str()) < 0; }
+      };
+      static void sortList(RangeList* list);
+      static void mergeList(RangeList* list, RangeList* page);
 
       // cover
 
-      int getCurrentCover(MemoryStruct* cover, TrackInfo* track = 0);
-      int getCover(MemoryStruct* cover, TrackInfo* track);
+      int getCurrentCover(MemoryStruct* cover, const TrackInfo* track = 0);
+      int getCover(MemoryStruct* cover, const TrackInfo* track);
+      int prefetchCover(const TrackInfo* track);
+      static std::string coverKey(const TrackInfo* track);
 
 
       // notification channel
 
       int startNotify();
       int stopNotify();
-      int checkNotify(uint64_t timeout = 0);
+      int checkNotify(uint64_t timeout = 0, int withUpdate = yes);
+      int isNotifyStarted() { return notify != 0; }
 
       // player steering
 
@@ -143,6 +269,12 @@ class LmcCom : public TcpChannel
          return execute("time", par);
       }
 
+      int isPlayerConnected()         // our mac is registered at the LMS
+      {
+         int connected = 0;
+         return queryInt("connected", connected) == success && connected == 1;
+      }
+
       const char* getLastQueryTitle() { return queryTitle ? queryTitle : ""; }
 
       int nextTrack()      { return execute("playlist index", "+1"); }
@@ -208,58 +340,171 @@ class LmcCom : public TcpChannel
       // infos
 
       int update(int stateOnly = no);
+      int parseStatus(const char* data);
+      void setTrackListener(TrackListener* l) { trackListener = l; }
 
-      TrackInfo* getCurrentTrack()
-      {
-         if (playerState.plIndex >= 0 && playerState.plIndex < (int)tracks.size())
-            return &tracks.at(playerState.plIndex);
+      // the current snapshot, may be called by any thread
 
-         return &dummyTrack;
-      }
+      SnapshotPtr getSnapshot()     { return std::atomic_load(&snapshot); }
+      void restore(PlaylistSnapshot* s);     // takes ownership
 
       int hasMetadataChanged() { return metaDataChanged; }
-
-      PlayerState* getPlayerState() { return &playerState; }
-
-      int getTrackCount()           { return tracks.size(); }
-      TrackInfo* getTrack(int idx)  { return &tracks[idx]; }
+      uint64_t getNotifiedAt()  { return notifiedAt; }       // [us] receive time of the last notification
 
       char* unescape(char* buf);       // url like encoding
       char* escape(const char* buf);
 
-      int request(const char* command, Parameters* par = 0);
-      int request(const char* command, const char* par);
+      int request(const char* command, Parameters* par = 0, const char* term = "\n");
+      int request(const char* command, const char* par, const char* term = "\n");
 
       int responseP(char*& result);
       int response(char* response = 0, int max = 0);
 
    private:
 
+      int perform(const char* command, Parameters* pars, char*& result);
+      int jsonCall(const char* command, Parameters* pars, char*& result);
+      int downloadCover(const char* url, MemoryStruct* cover, int cached = yes);
+      LmcTag* newTag();
+      int parseStatus(LmcTag* lt, PlaylistSnapshot* s);
+      void publish(PlaylistSnapshot* s);
+      LatencyStat* statOf(const char* command);
+
       void setQueryTitle(const char* title) { free(queryTitle); queryTitle = strdup(title); }
 
       // data
 
       char* host;
       unsigned short port;
+      unsigned short httpPort;
+      int transport;
+      LmcJsonRpc* json;
       char* mac;
       char* escId;                       // escaped player id (build from mac)
 
-      CURL* curl;
       char lastCommand[sizeMaxCommand+TB];
       std::string lastPar;
 
-      TrackInfo dummyTrack;
-      TrackInfo currentTrack;
-      PlayerState playerState;
+      SnapshotPtr snapshot;              // access by std::atomic_load/store only
+      uint64_t snapshotVersion;
       LmcCom* notify;
-      vector<TrackInfo> tracks;
       char* queryTitle;
       int metaDataChanged;
+      uint64_t notifiedAt;
+      TrackListener* trackListener;
 
 #ifdef VDR_PLUGIN
       cMutex comMutex;
 #endif
 };
 
+//***************************************************************************
+// Range Cache
+//  - process wide, the results of the library queries (queryRange) by
+//    query type, filters and window, oldest dropped first
+//  - cleared if the LMS notifies a rescan, results received while
+//    scanning aren't stored
+//  - cleared as well if the lastscan of a 'serverstatus' differs from
+//    the one the results belong to (rescan while nobody listened)
+//***************************************************************************
+
+class RangeCache
+{
+   public:
+
+      enum Misc
+      {
+         maxItems = 100000              // sum of the cached list items
+      };
+
+      static int get(const std::string& key, LmcCom::RangeList* list, int& total);
+      static void put(const std::string& key, const LmcCom::RangeList* list, int total);
+      static void clear();
+      static void setLastScan(long aLastScan);
+
+      static std::string toKey(LmcCom::RangeQueryType queryType, int from, int count,
+                               LmcCom::Parameters* pars);
+      static int isCacheable(LmcCom::RangeQueryType queryType);
+
+   private:
+
+      struct Entry
+      {
+         std::string key;
+         LmcCom::RangeList list;
+         int total;
+      };
+
+      static std::list<Entry> entries;  // latest first
+      static size_t items;
+      static long lastScan;             // of the LMS, 0 if not known yet
+      static std::mutex mutex;
+};
+
+//***************************************************************************
+// Radio Cache
+//  - process wide, the pages of the radios and radio apps (online content,
+//    slow to answer) by command, filters (item_id) and window
+//  - entries older than the TTL are still served (stale) and queued for a
+//    refresh, the refresher thread takes the requests (takeRequest) and
+//    queries them again without the cache
+//***************************************************************************
+
+class RadioCache
+{
+   public:
+
+      enum Misc
+      {
+         maxItems = 20000               // sum of the cached list items
+      };
+
+      struct Request
+      {
+         LmcCom::RangeQueryType queryType;
+         int from;
+         int count;
+         std::string special;
+         LmcCom::Parameters pars;
+         std::string key;
+      };
+
+      static int get(const std::string& key, LmcCom::RangeList* list, int& total, const Request* request);
+      static void put(const std::string& key, const LmcCom::RangeList* list, int total);
+      static void clear();
+
+      static int prefetch(const Request* request);      // queued if not cached
+      static int takeRequest(Request& request);
+      static void refreshDone(const std::string& key);
+
+      static void setTtl(int seconds)                   { ttl = seconds; }
+      static void setNotify(void (*aNotify)());
+
+      static std::string toKey(LmcCom::RangeQueryType queryType, int from, int count,
+                               const char* special, LmcCom::Parameters* pars);
+      static int isCacheable(LmcCom::RangeQueryType queryType);
+
+   private:
+
+      struct Entry
+      {
+         std::string key;
+         LmcCom::RangeList list;
+         int total;
+         time_t stored;
+         int refreshing;
+      };
+
+      static int queue(const Request* request);         // with locked mutex, yes if queued
+      static void signal(void (*wakeup)());             // without the mutex
+
+      static std::list<Entry> entries;  // latest first
+      static std::list<Request> requests;
+      static size_t items;
+      static std::mutex mutex;
+      static int ttl;                   // [s], 0 for no cache
+      static void (*notify)();          // wakes the refresher
+};
+
 //***************************************************************************
 #endif //  __LMCCOM_H
@@ -0,0 +1,658 @@
+/*
+ * lmcjson.c
+ *
+ * See the README file for copyright information
+ *
+ */
+
+#include <ctype.h>
+
+#include "lib/common.h"
+#include "lmcjson.h"
+
+//***************************************************************************
+// JSON Tag Reader
+//***************************************************************************
+//***************************************************************************
+// Set
+//***************************************************************************
+
+int LmcJsonTag::set(const char* data)
+{
+   char name[sizeName+TB];
+
+   depth = 0;
+
+   if (LmcTag::set(data) != success)
+      return fail;
+
+   // search the 'result' object in the top level object
+
+   skipBlanks();
+
+   if (*pos != '{')
+      return malformed();
+
+   pos++;
+
+   while (*pos)
+   {
+      skipBlanks();
+
+      if (*pos != '"' || parseString(name, sizeName) != success)
+         break;
+
+      skipBlanks();
+
+      if (*pos++ != ':')
+         break;
+
+      skipBlanks();
+
+      if (strcmp(name, "result") == 0 && *pos == '{')
+      {
+         stack[depth++] = *pos++;
+         return success;
+      }
+
+      if (skipValue() != success)
+         break;
+   }
+
+   tell(eloAlways, "Error: Got JSON-RPC answer without result object");
+   pos = buffer + strlen(buffer);
+
+   return fail;
+}
+
+//***************************************************************************
+// Get Next
+//***************************************************************************
+
+int LmcJsonTag::getNext(int& tag, char* value, unsigned short max, int track)
+{
+   int status;
+   int loopItem = no;
+   char name[sizeName+TB];
+
+   if ((status = next(name, value, max, loopItem)) != success)
+      return status;
+
+   if (loopItem)
+   {
+      tag = tLoopItem;
+      return success;
+   }
+
+   // below the result object we are inside of a loop element
+
+   tag = toTag(name, depth > 1);
+
+   return tag != tUnknown ? success : (int)wrnUnknownTag;
+}
+
+int LmcJsonTag::getNext(char* name, char* value, unsigned short max)
+{
+   int status;
+   int loopItem = no;
+
+   while ((status = next(name, value, max, loopItem)) == success && loopItem)
+      ;
+
+   return status;
+}
+
+//***************************************************************************
+// Next
+//***************************************************************************
+
+int LmcJsonTag::next(char* name, char* value, unsigned short max, int& loopItem)
+{
+   loopItem = no;
+   *name = 0;
+   *value = 0;
+
+   if (!pos)
+      return wrnEndOfPacket;
+
+   while (true)
+   {
+      skipBlanks();
+
+      if (!*pos || depth <= 0)
+         return wrnEndOfPacket;
+
+      if (*pos == '}' || *pos == ']')
+      {
+         pos++;
+
+         if (--depth <= 0)
+            return wrnEndOfPacket;
+
+         continue;
+      }
+
+      if (stack[depth-1] == '[')
+      {
+         // array of objects -> loop
+
+         if (*pos == '{' && depth < maxDepth)
+         {
+            stack[depth++] = *pos++;
+            loopItem = yes;
+            return success;
+         }
+
+         if (skipValue() != success)
+            return malformed();
+
+         continue;
+      }
+
+      // member of an object
+
+      if (*pos != '"' || parseString(name, sizeName) != success)
+         return malformed();
+
+      skipBlanks();
+
+      if (*pos++ != ':')
+         return malformed();
+
+      skipBlanks();
+
+      if (*pos == '[')
+      {
+         const char* p = pos + 1;
+
+         while (*p && isspace(*p))
+            p++;
+
+         if (*p == '{' && depth < maxDepth)
+         {
+            stack[depth++] = *pos++;
+            continue;
+         }
+      }
+
+      if (*pos == '{' || *pos == '[')
+      {
+         // nested objects (like remoteMeta) are not of interest
+
+         if (skipValue() != success)
+            return malformed();
+
+         continue;
+      }
+
+      if (parseScalar(value, max) != success)
+         return malformed();
+
+      return success;
+   }
+}
+
+//***************************************************************************
+// Parse String
+//  - pos at the opening quote, dest 0 to skip
+//***************************************************************************
+
+int LmcJsonTag::parseString(char* dest, int max)
+{
+   int len = 0;
+
+   pos++;
+
+   while (*pos && *pos != '"')
+   {
+      char c[4];
+      int n = 1;
+
+      if (*pos != '\\')
+      {
+         c[0] = *pos++;
+      }
+      else
+      {
+         pos++;
+
+         switch (*pos)
+         {
+            case 'b': c[0] = '\b'; break;
+            case 'f': c[0] = '\f'; break;
+            case 'n': c[0] = '\n'; break;
+            case 'r': c[0] = '\r'; break;
+            case 't': c[0] = '\t'; break;
+
+            case 'u':
+            {
+               unsigned int cp = 0;
+
+               if (sscanf(pos+1, "%4x", &cp) != 1)
+                  return fail;
+
+               pos += 4;
+
+               // surrogate pair
+
+               if (cp >= 0xD800 && cp <= 0xDBFF && pos[1] == '\\' && pos[2] == 'u')
+               {
+                  unsigned int lo = 0;
+
+                  if (sscanf(pos+3, "%4x", &lo) == 1 && lo >= 0xDC00 && lo <= 0xDFFF)
+                  {
+                     cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                     pos += 6;
+                  }
+               }
+
+               // to UTF-8
+
+               if (cp < 0x80)
+                  c[0] = cp;
+               else if (cp < 0x800)
+               {
+                  c[0] = 0xC0 | (cp >> 6);
+                  c[1] = 0x80 | (cp & 0x3F);
+                  n = 2;
+               }
+               else if (cp < 0x10000)
+               {
+                  c[0] = 0xE0 | (cp >> 12);
+                  c[1] = 0x80 | ((cp >> 6) & 0x3F);
+                  c[2] = 0x80 | (cp & 0x3F);
+                  n = 3;
+               }
+               else
+               {
+                  c[0] = 0xF0 | (cp >> 18);
+                  c[1] = 0x80 | ((cp >> 12) & 0x3F);
+                  c[2] = 0x80 | ((cp >> 6) & 0x3F);
+                  c[3] = 0x80 | (cp & 0x3F);
+                  n = 4;
+               }
+
+               break;
+            }
+
+            case 0: return fail;
+            default: c[0] = *pos; break;   // '"', '\\' and '/'
+         }
+
+         pos++;
+      }
+
+      if (dest && len + n <= max)
+      {
+         memcpy(dest+len, c, n);
+         len += n;
+      }
+   }
+
+   if (*pos != '"')
+      return fail;
+
+   pos++;
+
+   if (dest)
+      dest[len] = 0;
+
+   return success;
+}
+
+//***************************************************************************
+// Parse Scalar
+//***************************************************************************
+
+int LmcJsonTag::parseScalar(char* value, int max)
+{
+   if (*pos == '"')
+      return parseString(value, max);
+
+   const char* start = pos;
+
+   while (*pos && !strchr(",}] \t\r\n", *pos))
+      pos++;
+
+   int len = pos - start;
+
+   if (!len)
+      return fail;
+
+   if (len == 4 && strncmp(start, "true", 4) == 0)
+      sprintf(value, "1");
+   else if (len == 5 && strncmp(start, "false", 5) == 0)
+      sprintf(value, "0");
+   else if (len == 4 && strncmp(start, "null", 4) == 0)
+      *value = 0;
+   else
+      snprintf(value, max+TB, "%.*s", len, start);
+
+   return success;
+}
+
+//***************************************************************************
+// Skip Value
+//***************************************************************************
+
+int LmcJsonTag::skipValue()
+{
+   int level = 0;
+
+   if (*pos == '"')
+      return parseString(0, 0);
+
+   if (*pos != '{' && *pos != '[')
+   {
+      char dummy[sizeName+TB];
+      return parseScalar(dummy, sizeName);
+   }
+
+   while (*pos)
+   {
+      if (*pos == '"')
+      {
+         if (parseString(0, 0) != success)
+            return fail;
+
+         continue;
+      }
+
+      if (*pos == '{' || *pos == '[')
+         level++;
+      else if ((*pos == '}' || *pos == ']') && --level == 0)
+      {
+         pos++;
+         return success;
+      }
+
+      pos++;
+   }
+
+   return fail;
+}
+
+void LmcJsonTag::skipBlanks()
+{
+   while (*pos && (isspace(*pos) || *pos == ','))
+      pos++;
+}
+
+int LmcJsonTag::malformed()
+{
+   tell(eloAlways, "Error: Malformed JSON-RPC answer near [%.*s]", 50, pos);
+
+   pos = buffer + strlen(buffer);
+   depth = 0;
+
+   return wrnEndOfPacket;
+}
+
+//***************************************************************************
+// JSON-RPC Channel
+//***************************************************************************
+
+LmcJsonRpc::LmcJsonRpc()
+   : TcpChannel()
+{
+   host = 0;
+   port = 0;
+   id = 0;
+   keepAlive = yes;
+}
+
+LmcJsonRpc::~LmcJsonRpc()
+{
+   close();
+   free(host);
+}
+
+//***************************************************************************
+// Open
+//***************************************************************************
+
+int LmcJsonRpc::open(const char* aHost, unsigned short aPort)
+{
+   if (host != aHost)
+   {
+      free(host);
+      host = strdup(aHost);
+   }
+
+   port = aPort;
+   keepAlive = yes;
+
+   return TcpChannel::open(port, host);
+}
+
+//***************************************************************************
+// Call
+//***************************************************************************
+
+int LmcJsonRpc::call(const char* player, LmcCom::Parameters* tokens, char*& result)
+{
+   char tmp[100];
+   LmcCom::Parameters::iterator it;
+
+   result = 0;
+
+   sprintf(tmp, "{\"id\":%u,\"method\":\"slim.request\",\"params\":[", ++id);
+   body = tmp;
+   addString(player);
+   body += ",[";
+
+   for (it = tokens->begin(); it != tokens->end(); ++it)
+   {
+      if (it != tokens->begin())
+         body += ",";
+
+      addString((*it).c_str());
+   }
+
+   body += "]]}";
+
+   // a keep-alive connection may be closed by the server meanwhile, retry once
+
+   for (int retry = 0; retry < 2; retry++)
+   {
+      if (!isOpen() && open(host, port) != success)
+      {
+         tell(eloAlways, "Error: Opening JSON-RPC connection to '%s:%d' failed", host, port);
+         return fail;
+      }
+
+      if (perform(result) == success)
+         return success;
+
+      close();
+   }
+
+   return fail;
+}
+
+//***************************************************************************
+// Perform
+//***************************************************************************
+
+int LmcJsonRpc::perform(char*& result)
+{
+   char len[20];
+
+   sprintf(len, "%d", (int)body.length());
+
+   header = "POST /jsonrpc.js HTTP/1.1\r\nHost: ";
+   header += host;
+   header += "\r\nContent-Type: application/json\r\nContent-Length: ";
+   header += len;
+   header += "\r\nConnection: keep-alive\r\n\r\n";
+
+   tell(eloDebug, "Requesting JSON-RPC '%s'", body.c_str());
+
+   flush();
+
+   if (write((header + body).c_str()) != success)
+      return fail;
+
+   if (readResponse(result) != success)
+      return fail;
+
+   if (!keepAlive)
+      close();
+
+   return success;
+}
+
+//***************************************************************************
+// Read Response
+//***************************************************************************
+
+int LmcJsonRpc::readResponse(char*& result)
+{
+   char* line;
+   int code = 0;
+   int contentLength = na;
+   int chunked = no;
+   int complete = no;
+   int size = 0;
+
+   keepAlive = yes;
+
+   if (look(30000) != success || !(line = readln()))
+      return fail;
+
+   sscanf(line, "HTTP/%*s %d", &code);
+   free(line);
+
+   // header
+
+   while ((line = readln()))
+   {
+      rTrim(line);
+
+      if (!*line)
+         break;
+
+      if (strncasecmp(line, "Content-Length:", 15) == 0)
+         contentLength = atoi(line+15);
+      else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0 && strcasestr(line+18, "chunked"))
+         chunked = yes;
+      else if (strncasecmp(line, "Connection:", 11) == 0 && strcasestr(line+11, "close"))
+         keepAlive = no;
+
+      free(line);
+   }
+
+   if (!line)
+      return fail;
+
+   free(line);
+
+   // body
+
+   if (chunked)
+   {
+      int chunkSize;
+
+      while ((line = readln()))
+      {
+         chunkSize = strtol(line, 0, 16);
+         free(line);
+
+         if (chunkSize <= 0)
+         {
+            // skip trailer up to the empty line
+
+            while ((line = readln()) && *rTrim(line))
+               free(line);
+
+            complete = line != 0;
+            free(line);
+            break;
+         }
+
+         result = (char*)realloc(result, size + chunkSize + TB);
+
+         if (readBlock(result+size, chunkSize) != success)
+            break;
+
+         size += chunkSize;
+         free(readln());          // CRLF behind the chunk
+      }
+   }
+   else if (contentLength >= 0)
+   {
+      result = (char*)malloc(contentLength + TB);
+
+      if (readBlock(result, contentLength) == success)
+      {
+         size = contentLength;
+         complete = yes;
+      }
+   }
+   else
+   {
+      tell(eloAlways, "Error: JSON-RPC answer without content length");
+   }
+
+   // a truncated body leaves the rest of it in the stream, the
+   // connection is of no use for the next request
+
+   if (!complete)
+   {
+      tell(eloAlways, "Error: JSON-RPC answer truncated after %d bytes", size);
+      free(result);
+      result = 0;
+      close();
+      return fail;
+   }
+
+   if (result)
+      result[size] = 0;
+
+   if (code != 200 || !size)
+   {
+      tell(eloAlways, "Error: JSON-RPC request failed with HTTP status %d", code);
+      free(result);
+      result = 0;
+      return fail;
+   }
+
+   tell(eloDebug2, "<- (JSON-RPC response %d bytes) [%s]", size, result);
+
+   return success;
+}
+
+//***************************************************************************
+// Add String
+//***************************************************************************
+
+void LmcJsonRpc::addString(const char* str)
+{
+   body += '"';
+
+   for (const char* p = str; *p; p++)
+   {
+      switch (*p)
+      {
+         case '"':  body += "\\\""; break;
+         case '\\': body += "\\\\"; break;
+         case '\n': body += "\\n";  break;
+         case '\r': body += "\\r";  break;
+         case '\t': body += "\\t";  break;
+
+         default:
+         {
+            if ((unsigned char)*p < 0x20)
+            {
+               char tmp[10];
+               sprintf(tmp, "\\u%04x", *p);
+               body += tmp;
+            }
+            else
+               body += *p;
+         }
+      }
+   }
+
+   body += '"';
+}
@@ -0,0 +1,89 @@
+/*
+ * lmcjson.h
+ *
+ * See the README file for copyright information
+ *
+ */
+
+#ifndef __LMCJSON_H
+#define __LMCJSON_H
+
+#include <string>
+
+#include "lib/tcpchannel.h"
+#include "lmccom.h"
+#include "lmctag.h"
+
+//***************************************************************************
+// LMC JSON-RPC Tag Reader
+//  - pull parser, walks the 'result' object of a JSON-RPC answer and
+//    delivers the same tags as the CLI parser, without building a tree
+//***************************************************************************
+
+class LmcJsonTag : public LmcTag
+{
+   public:
+
+      LmcJsonTag(LmcCom* l) : LmcTag(l) { depth = 0; }
+
+      int set(const char* data);
+
+      int getNext(int& tag, char* value, unsigned short max, int track = no);
+      int getNext(char* name, char* value, unsigned short max);
+
+      int marksItems() { return yes; }
+
+   protected:
+
+      enum Misc
+      {
+         maxDepth = 32,
+         sizeName = 100
+      };
+
+      int next(char* name, char* value, unsigned short max, int& loopItem);
+      int parseString(char* dest, int max);
+      int parseScalar(char* value, int max);
+      int skipValue();
+      void skipBlanks();
+      int malformed();
+
+      char stack[maxDepth];
+      int depth;
+};
+
+//***************************************************************************
+// LMC JSON-RPC Channel
+//  - keep-alive HTTP connection to the /jsonrpc.js service of the LMS
+//***************************************************************************
+
+class LmcJsonRpc : public TcpChannel
+{
+   public:
+
+      LmcJsonRpc();
+      ~LmcJsonRpc();
+
+      int open(const char* aHost, unsigned short aPort);
+
+      // perform 'slim.request' for player with the (unescaped) command tokens,
+      //   result is the complete JSON answer, caller has to free it
+
+      int call(const char* player, LmcCom::Parameters* tokens, char*& result);
+
+   private:
+
+      int perform(char*& result);
+      int readResponse(char*& result);
+      void addString(const char* str);
+
+      char* host;
+      unsigned short port;
+      unsigned int id;
+      int keepAlive;
+      std::string body;
+      std::string header;
+};
+
+//***************************************************************************
+#endif //  __LMCJSON_H
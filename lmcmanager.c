@@ -0,0 +1,417 @@
+/*
+ * lmcmanager.c
+ *
+ * See the README file for copyright information
+ *
+ */
+
+#include "lib/common.h"
+#include "lib/stats.h"
+
+#include "config.h"
+#include "lmcmanager.h"
+
+LmcCom* LmcManager::lmc = 0;
+int LmcManager::refCount = 0;
+cMutex LmcManager::mutex;
+cLmcWatcher* LmcManager::watcher = 0;
+cRadioRefresher* LmcManager::refresher = 0;
+PlaylistSnapshot* LmcManager::restored = 0;
+
+//***************************************************************************
+// Acquire
+//  - a failed open isn't fatal, the users retry by lmc->open() as before
+//***************************************************************************
+
+LmcCom* LmcManager::acquire()
+{
+   cMutexLock lock(&mutex);
+
+   if (!lmc)
+   {
+      lmc = new LmcCom(cfg.mac);
+      lmc->setTransport(cfg.jsonRpc ? LmcCom::ttJsonRpc : LmcCom::ttCli, cfg.lmcHttpPort);
+      lmc->setNoDelay(cfg.tcpNoDelay);
+
+      if (restored)
+      {
+         lmc->restore(restored);          // the OSD can draw before the LMS answers
+         restored = 0;
+      }
+
+      tell(eloAlways, "Trying connetion to '%s:%d', my mac is '%s'",
+           cfg.lmcHost, cfg.lmcPort, cfg.mac);
+
+      if (lmc->open(cfg.lmcHost, cfg.lmcPort) != success)
+         tell(eloAlways, "Error: Opening connection to LMC server at '%s:%d' failed",
+              cfg.lmcHost, cfg.lmcPort);
+      else
+         tell(eloAlways, "Connection to LMC server at '%s:%d' established",
+              cfg.lmcHost, cfg.lmcPort);
+   }
+
+   refCount++;
+
+   return lmc;
+}
+
+//***************************************************************************
+// Release
+//***************************************************************************
+
+void LmcManager::release()
+{
+   cMutexLock lock(&mutex);
+
+   if (!refCount || --refCount)
+      return;
+
+   tell(eloDetail, "Closing connection to LMC server, no more users");
+
+   delete lmc;
+   lmc = 0;
+}
+
+//***************************************************************************
+// Restore Snapshot
+//  - the state loaded from the state cache, published by the connection
+//***************************************************************************
+
+void LmcManager::restoreSnapshot(PlaylistSnapshot* s)
+{
+   cMutexLock lock(&mutex);
+
+   if (lmc)
+   {
+      lmc->restore(s);
+      return;
+   }
+
+   delete restored;
+   restored = s;
+}
+
+//***************************************************************************
+// Get
+//***************************************************************************
+
+LmcCom* LmcManager::get()
+{
+   cMutexLock lock(&mutex);
+
+   return lmc;
+}
+
+//***************************************************************************
+// Watcher Steering
+//  - called by the plugin (start/stop) and the OSD thread (suspend/resume)
+//***************************************************************************
+
+int LmcManager::startWatcher()
+{
+   if (watcher)
+      return done;
+
+   watcher = new cLmcWatcher();
+   watcher->Start();
+
+   return success;
+}
+
+int LmcManager::stopWatcher()
+{
+   delete watcher;
+   watcher = 0;
+
+   return success;
+}
+
+int LmcManager::suspendWatcher()
+{
+   if (!watcher)
+      return fail;
+
+   watcher->suspend();
+
+   return success;
+}
+
+int LmcManager::resumeWatcher()
+{
+   if (!watcher)
+      return fail;
+
+   watcher->resume();
+
+   return success;
+}
+
+//***************************************************************************
+// Refresher Steering
+//  - the radio cache signals new requests by wakeupRefresher()
+//***************************************************************************
+
+int LmcManager::startRefresher()
+{
+   if (refresher)
+      return done;
+
+   refresher = new cRadioRefresher();
+   refresher->Start();
+   RadioCache::setNotify(wakeupRefresher);
+
+   return success;
+}
+
+int LmcManager::stopRefresher()
+{
+   RadioCache::setNotify(0);
+
+   delete refresher;
+   refresher = 0;
+
+   return success;
+}
+
+void LmcManager::wakeupRefresher()
+{
+   if (refresher)
+      refresher->wakeup();
+}
+
+//***************************************************************************
+// LMC Watcher
+//***************************************************************************
+
+cLmcWatcher::cLmcWatcher()
+   : cThread("squeezebox-watcher")
+{
+   suspended = 0;
+}
+
+cLmcWatcher::~cLmcWatcher()
+{
+   stop();
+}
+
+void cLmcWatcher::stop()
+{
+   Cancel(-1);
+   waitCondition.Signal();
+
+   // no hard cancel, the update may hold the lock of the shared connection
+
+   while (Active())
+      cCondWait::SleepMs(10);
+}
+
+//***************************************************************************
+// Suspend / Resume
+//  - suspend waits until a running check of the notifications is finished,
+//    the notification channel stays open and is handed over to the OSD
+//***************************************************************************
+
+void cLmcWatcher::suspend()
+{
+   cMutexLock lock(&suspendMutex);
+
+   suspended++;
+}
+
+void cLmcWatcher::resume()
+{
+   cMutexLock lock(&suspendMutex);
+
+   if (suspended)
+      suspended--;
+
+   waitCondition.Signal();
+}
+
+//***************************************************************************
+// Action
+//***************************************************************************
+
+void cLmcWatcher::Action()
+{
+   LmcCom* lmc = LmcManager::acquire();
+
+   tell(eloDetail, "LMC watcher started");
+
+   while (Running())
+   {
+      int waitMs;
+      int changed = no;
+
+      {
+         cMutexLock lock(&suspendMutex);
+         waitMs = watch(lmc, changed);
+      }
+
+      // the update and the cover downloads may take seconds, a
+      // suspend() of the OSD doesn't wait for them
+
+      if (changed && Running())
+      {
+         static LatencyStat* stat = Statistics::get("notify.update");
+
+         {
+            LatencyProbe probe(stat);
+            lmc->update();
+         }
+
+         prefetch(lmc);
+      }
+
+      if (waitMs)
+         waitCondition.Wait(waitMs);    // outside the lock, don't block the OSD
+   }
+
+   if (lmc->isNotifyStarted())
+      lmc->stopNotify();
+
+   LmcManager::release();
+
+   tell(eloDetail, "LMC watcher stopped");
+}
+
+//***************************************************************************
+// Watch
+//  - one check of the notifications, returns the time [ms] to wait
+//    before the next one, 'changed' if the state has to be updated
+//***************************************************************************
+
+int cLmcWatcher::watch(LmcCom* lmc, int& changed)
+{
+   if (suspended)
+      return 1000;
+
+   if (!lmc->isOpen() && lmc->open(cfg.lmcHost, cfg.lmcPort) != success)
+      return 5000;
+
+   // (re)subscribe, the OSD closes the notification channel if no
+   // watcher was running when it ended
+
+   if (!lmc->isNotifyStarted())
+   {
+      long lastScan;
+      int scanning;
+
+      if (lmc->startNotify() != success)
+      {
+         lmc->stopNotify();        // the 'listen 1' may have failed on an open channel
+         return 5000;
+      }
+
+      // a rescan meanwhile isn't notified, the lastscan drops the menu cache
+
+      lmc->queryServerStatus(lastScan, scanning);
+
+      changed = yes;               // missed everything meanwhile
+      return 0;
+   }
+
+   int status = lmc->checkNotify(notifyTimeout, no);
+
+   if (status == fail)
+   {
+      lmc->stopNotify();           // LMS restarted, subscribe again next time
+      return 1000;
+   }
+
+   changed = status == success;
+
+   return 0;
+}
+
+//***************************************************************************
+// Prefetch
+//  - download the covers of the current and the following tracks into the
+//    cover cache, known covers are cheap (cache hit)
+//***************************************************************************
+
+void cLmcWatcher::prefetch(LmcCom* lmc)
+{
+   SnapshotPtr s = lmc->getSnapshot();
+   int first = s->state.plIndex > 0 ? s->state.plIndex : 0;
+
+   for (int i = first; i < s->getTrackCount() && i < first + prefetchTracks && Running(); i++)
+      lmc->prefetchCover(s->getTrack(i));
+}
+
+//***************************************************************************
+// Radio Refresher
+//***************************************************************************
+
+cRadioRefresher::cRadioRefresher()
+   : cThread("squeezebox-radio")
+{
+}
+
+cRadioRefresher::~cRadioRefresher()
+{
+   stop();
+}
+
+void cRadioRefresher::stop()
+{
+   Cancel(-1);
+   waitCondition.Signal();
+
+   // no hard cancel, a running query holds the lock of the shared
+   // connection, it's finished before the next request is taken
+
+   while (Active())
+      cCondWait::SleepMs(10);
+}
+
+//***************************************************************************
+// Action
+//***************************************************************************
+
+void cRadioRefresher::Action()
+{
+   LmcCom* lmc = LmcManager::acquire();
+   RadioCache::Request request;
+
+   tell(eloDetail, "Radio refresher started");
+
+   while (Running())
+   {
+      if (RadioCache::takeRequest(request) != success)
+      {
+         waitCondition.Wait(5000);
+         continue;
+      }
+
+      LmcCom::RangeList list;
+      int total = 0;
+
+      if (!lmc->isOpen() && lmc->open(cfg.lmcHost, cfg.lmcPort) != success)
+      {
+         RadioCache::refreshDone(request.key);
+         waitCondition.Wait(5000);
+         continue;
+      }
+
+      // without the cache, the result replaces the stale entry
+
+      if (lmc->queryRange(request.queryType, request.from, request.count, &list, total,
+                          request.special.c_str(), &request.pars, no) != success)
+         tell(eloDetail, "Refresh of radio page '%s' failed", request.key.c_str());
+      else
+         tell(eloDebug, "Refreshed radio page '%s' (%d items)", request.key.c_str(), (int)list.size());
+
+      RadioCache::refreshDone(request.key);
+
+      // the query held the shared connection, the refresh isn't urgent,
+      // give the others a chance before the next one (not shortened by
+      // a wakeup() of new requests)
+
+      cCondWait::SleepMs(refreshPause);
+   }
+
+   LmcManager::release();
+
+   tell(eloDetail, "Radio refresher stopped");
+}
@@ -0,0 +1,119 @@
+/*
+ * lmcmanager.h
+ *
+ * See the README file for copyright information
+ *
+ */
+
+#ifndef __LMCMANAGER_H
+#define __LMCMANAGER_H
+
+#include <vdr/thread.h>
+
+#include "lmccom.h"
+
+//***************************************************************************
+// LMC Manager
+//  - process wide owner of the one LMS connection (command channel and
+//    the notification channel started by the OSD), shared by control,
+//    OSD, menus and SVDRP instead of a connection per user
+//***************************************************************************
+
+class LmcManager
+{
+   public:
+
+      static LmcCom* acquire();          // created and opened for the first user
+      static void release();             // closed with the last user
+      static LmcCom* get();              // no reference taken, 0 if nobody uses the connection
+      static void restoreSnapshot(PlaylistSnapshot* s);   // takes ownership
+
+      // watcher, keeps the state and covers warm while no OSD is open
+
+      static int startWatcher();
+      static int stopWatcher();
+      static int suspendWatcher();       // the OSD takes over the notifications
+      static int resumeWatcher();        // fail if there is no watcher
+
+      // refresher of the radio cache
+
+      static int startRefresher();
+      static int stopRefresher();
+
+   private:
+
+      static void wakeupRefresher();
+
+      static LmcCom* lmc;
+      static int refCount;
+      static cMutex mutex;
+      static class cLmcWatcher* watcher;
+      static class cRadioRefresher* refresher;
+      static PlaylistSnapshot* restored; // until the connection is created
+};
+
+//***************************************************************************
+// LMC Watcher
+//  - started with the plugin, holds the connection, listens to the
+//    notifications and prefetches the covers around the current track
+//    so the OSD paints complete with the first frame
+//***************************************************************************
+
+class cLmcWatcher : public cThread
+{
+   public:
+
+      enum Misc
+      {
+         prefetchTracks = 10,        // current and following tracks
+         notifyTimeout  = 200        // [ms]
+      };
+
+      cLmcWatcher();
+      virtual ~cLmcWatcher();
+
+      void stop();
+      void suspend();
+      void resume();
+
+   protected:
+
+      virtual void Action();
+      int watch(LmcCom* lmc, int& changed);
+      void prefetch(LmcCom* lmc);
+
+      int suspended;
+      cMutex suspendMutex;           // held while the watcher uses the notifications
+      cCondWait waitCondition;
+};
+
+//***************************************************************************
+// Radio Refresher
+//  - queries the stale and prefetched pages of the radio cache again,
+//    the menus get the cached pages meanwhile
+//***************************************************************************
+
+class cRadioRefresher : public cThread
+{
+   public:
+
+      enum Misc
+      {
+         refreshPause = 500          // [ms] between two queries, the OSD and the menus get the connection
+      };
+
+      cRadioRefresher();
+      virtual ~cRadioRefresher();
+
+      void stop();
+      void wakeup()      { waitCondition.Signal(); }
+
+   protected:
+
+      virtual void Action();
+
+      cCondWait waitCondition;
+};
+
+//***************************************************************************
+#endif // __LMCMANAGER_H
@@ -87,6 +87,9 @@ const char* LmcTag::tags[] =
    "remoteMeta",
    "type",                 // tContentType
    "lyrics",
+   "tracknum",
+   "tags",                 // echo of the requested tags
+   "textkey",              // first letter as used for the sort order
    "radio",
 
    "name",
@@ -101,6 +104,8 @@ const char* LmcTag::tags[] =
    "image",
    "waitingToPlay",
 
+   "<loop item>",
+
    0
 };
 
@@ -208,3 +213,60 @@ int LmcTag::getNextToken()
 
    return success;
 }
+
+//***************************************************************************
+// Stream Tag
+//***************************************************************************
+
+LmcStreamTag::~LmcStreamTag()
+{
+   // consume the rest of the line, the channel expects the next answer at a line start
+
+   while (!lastToken && lmc->readToken(token, sizeof(token)-TB, lastToken) == success)
+      ;
+}
+
+int LmcStreamTag::set(const char* echo)
+{
+   char* buf = strdup(echo);
+   char* p = buf;
+   int status = success;
+
+   // skip the echo of the request, token by token, the first one is the
+   // player id, the LMS echoes it in its own form (case, escaping), not checked
+
+   for (int first = yes; p && status == success; first = no)
+   {
+      char* expected = p;
+
+      if ((p = strchr(p, ' ')))
+         *p++ = 0;
+
+      if (lastToken || lmc->readToken(token, sizeof(token)-TB, lastToken) != success)
+         status = fail;
+      else if (!first && strcmp(token, expected) != 0)
+      {
+         tell(eloAlways, "Got unexpected answer for '%s' [%s]", echo, token);
+         status = fail;
+      }
+   }
+
+   free(buf);
+
+   return status;
+}
+
+int LmcStreamTag::getNextToken()
+{
+   if (lastToken)
+      return wrnEndOfPacket;
+
+   if (lmc->readToken(token, sizeof(token)-TB, lastToken) != success)
+   {
+      lastToken = yes;        // give up the line
+      truncated = yes;
+      return wrnEndOfPacket;
+   }
+
+   return success;
+}
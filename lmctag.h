@@ -5,6 +5,9 @@
  *
  */
 
+#ifndef __LMCTAG_H
+#define __LMCTAG_H
+
 #include "lib/common.h"
 
 #include "lmccom.h"
@@ -105,6 +108,9 @@ class LmcTag
          tRemoteMeta,
          tContentType,
          tLyrics,
+         tTrackNum,
+         tTags,
+         tTextKey,
 
          // are this tags :o, at leased used for the menu struct
 
@@ -126,6 +132,8 @@ class LmcTag
 
          // technical stuff ..
 
+         tLoopItem,         // start of the next loop element (JSON-RPC only)
+
          tCount
       };
 
@@ -141,22 +149,53 @@ class LmcTag
          pos = 0;
       }
 
-      ~LmcTag()
+      virtual ~LmcTag()
       {
          free(buffer);
       }
 
-      int set(const char* data);
+      virtual int set(const char* data);
+
+      virtual int getNext(int& tag, char* value, unsigned short max, int track = no);
+      virtual int getNext(char* name, char* value, unsigned short max);
 
-      int getNext(int& tag, char* value, unsigned short max, int track = no);
-      int getNext(char* name, char* value, unsigned short max);
+      virtual int marksItems() { return no; }   // reports loop elements by tLoopItem?
+      virtual int isTruncated() { return no; }  // the answer ended before its end of line
 
    protected:
 
-      int getNextToken();
+      virtual int getNextToken();
 
       char token[2000+TB];
       char* buffer;
       char* pos;
       LmcCom* lmc;   // only to call unescape() -> #TODO redisign later?
 };
+
+//***************************************************************************
+// LmcStreamTag
+//  - reads the tokens of a CLI answer directly from the socket while the
+//    line is still arriving, instead of the whole line set() gets the
+//    echo of the request (player id and command) which is skipped
+//***************************************************************************
+
+class LmcStreamTag : public LmcTag
+{
+   public:
+
+      LmcStreamTag(LmcCom* l) : LmcTag(l) { lastToken = no; truncated = no; }
+      virtual ~LmcStreamTag();
+
+      virtual int set(const char* echo);
+      virtual int isTruncated() { return truncated; }
+
+   protected:
+
+      virtual int getNextToken();
+
+      int lastToken;
+      int truncated;          // read failed (timeout, connection closed)
+};
+
+//***************************************************************************
+#endif //  __LMCTAG_H
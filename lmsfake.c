@@ -0,0 +1,1068 @@
+/*
+ * lmsfake.c
+ *
+ * Local stand-in for the Logitech Media Server (CLI and HTTP port),
+ * replays recorded sessions or generates synthetic libraries to
+ * exercise LmcCom, LmcTag and the menus without a real server
+ *
+ * See the README file for copyright information
+ *
+ */
+
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <stdio.h>
+
+#include <curl/curl.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <thread>
+#include <mutex>
+
+#include "lib/common.h"
+#include "lib/tcpchannel.h"
+
+int doShutdown = no;
+
+//***************************************************************************
+// Options
+//***************************************************************************
+
+struct Options
+{
+   unsigned short cliPort = 9090;
+   unsigned short httpPort = 9000;
+
+   const char* replayFile = 0;
+   const char* recordFile = 0;
+   const char* lmsHost = 0;       // real server (record mode)
+   unsigned short lmsPort = 9090;
+   const char* coverFile = 0;
+
+   int playlistTracks = 50;
+   int artists = 1000;
+
+   int delay = 0;                 // [ms] for each response
+   int dropRate = 0;              // [%] of responses to drop
+   int burstCount = 0;            // notifications per burst
+   int burstInterval = 1000;      // [ms] between bursts
+   unsigned int seed = 1;
+};
+
+Options opt;
+
+//***************************************************************************
+// Replay Data
+//***************************************************************************
+
+struct Exchange
+{
+   std::string response;          // without the leading player id
+   int delay;
+   int drop;
+};
+
+struct Replay
+{
+   std::vector<Exchange> exchanges;
+   unsigned int next = 0;
+};
+
+std::map<std::string, Replay> replays;    // key: request without the player id
+std::vector<std::string> notifications;   // without the leading player id
+std::mutex replayMutex;
+
+//***************************************************************************
+// Clients
+//***************************************************************************
+
+struct Client
+{
+   TcpChannel* channel;
+   std::mutex writeMutex;
+   int listen;
+
+   int send(const std::string& line)
+   {
+      std::lock_guard<std::mutex> lock(writeMutex);
+      return channel->write((line + "\n").c_str());
+   }
+};
+
+std::list<Client*> clients;
+std::mutex clientMutex;
+std::string lastPlayer = "00%3A00%3A00%3A00%3A00%3A00";
+
+// player state of the synthetic server
+
+struct State
+{
+   int index = 0;
+   int volume = 50;
+   int muted = no;
+   char mode[20] = "stop";
+} state;
+
+//***************************************************************************
+// Usage
+//***************************************************************************
+
+void showUsage(const char* name)
+{
+   printf("Usage: %s [options]\n", name);
+   printf("    -l <log-level>     set log level\n");
+   printf("    -p <port>          CLI port (default 9090)\n");
+   printf("    -H <port>          HTTP port for covers and JSON-RPC (default 9000)\n");
+   printf("    -r <file>          replay file, unknown requests are answered synthetic\n");
+   printf("    -R <file>          record the session with a real LMS (proxy mode)\n");
+   printf("    -h <host>          real LMS host (record mode)\n");
+   printf("    -P <port>          real LMS CLI port (record mode, default 9090)\n");
+   printf("    -c <file>          image delivered for each cover request\n");
+   printf("    -t <count>         tracks in the current playlist (default 50)\n");
+   printf("    -a <count>         artists of the synthetic library (default 1000)\n");
+   printf("    -d <ms>            delay of each response\n");
+   printf("    -D <percent>       drop rate of responses\n");
+   printf("    -n <count>         notifications per burst to all 'listen' clients\n");
+   printf("    -i <ms>            interval of the notification bursts (default 1000)\n");
+   printf("    -s <seed>          seed for the drop decision (default 1)\n");
+   printf("\n");
+   printf("  Replay file format (one line per entry, CLI lines as on the wire):\n");
+   printf("    # comment\n");
+   printf("    > <player-id> <request>     request of the client\n");
+   printf("    < <player-id> <response>    response to the request above\n");
+   printf("    @delay <ms>                 delay the next response\n");
+   printf("    @drop                       drop the next response\n");
+   printf("    @notify <player-id> <line>  notification for the bursts\n");
+}
+
+//***************************************************************************
+// Tools
+//***************************************************************************
+
+std::string cliEscape(const std::string& str)
+{
+   char* p = curl_easy_escape(0, str.c_str(), str.length());
+   std::string res = p ? p : "";
+
+   curl_free(p);
+
+   return res;
+}
+
+std::string cliUnescape(const std::string& str)
+{
+   int len = 0;
+   char* p = curl_easy_unescape(0, str.c_str(), str.length(), &len);
+   std::string res = p ? std::string(p, len) : "";
+
+   curl_free(p);
+
+   return res;
+}
+
+// split "<player> <rest>" at the first blank
+
+std::string cutPlayer(const std::string& line, std::string* player = 0)
+{
+   size_t pos = line.find(' ');
+
+   if (player)
+      *player = line.substr(0, pos);
+
+   return pos != std::string::npos ? line.substr(pos+1) : "";
+}
+
+void tokenize(const std::string& line, std::vector<std::string>& tokens)
+{
+   size_t start = 0, end;
+
+   tokens.clear();
+
+   while (start < line.length())
+   {
+      if ((end = line.find(' ', start)) == std::string::npos)
+         end = line.length();
+
+      if (end > start)
+         tokens.push_back(cliUnescape(line.substr(start, end-start)));
+
+      start = end + 1;
+   }
+}
+
+int dropResponse(int drop)
+{
+   if (drop)
+      return yes;
+
+   return opt.dropRate > 0 && (int)(rand() % 100) < opt.dropRate;
+}
+
+//***************************************************************************
+// Load Replay File
+//***************************************************************************
+
+int loadReplay(const char* path)
+{
+   FILE* fp;
+   char* line = 0;
+   size_t size = 0;
+   int count = 0;
+   int delay = 0, drop = no;
+   std::string request;
+
+   if (!(fp = fopen(path, "r")))
+   {
+      tell(eloAlways, "Error: Can't open replay file '%s', %m", path);
+      return fail;
+   }
+
+   while (getline(&line, &size, fp) > 0)
+   {
+      rTrim(line);
+
+      if (!*line || *line == '#')
+         continue;
+
+      if (strncmp(line, "> ", 2) == 0)
+      {
+         // a request without recorded response was dropped
+
+         if (request != "")
+            replays[request].exchanges.push_back({ "", delay, yes });
+
+         request = cutPlayer(line+2);
+      }
+      else if (strncmp(line, "< ", 2) == 0 && request != "")
+      {
+         replays[request].exchanges.push_back({ cutPlayer(line+2), delay, drop });
+         request = "";
+         delay = 0;
+         drop = no;
+         count++;
+      }
+      else if (strncmp(line, "@delay ", 7) == 0)
+         delay = atoi(line+7);
+      else if (strcmp(line, "@drop") == 0)
+         drop = yes;
+      else if (strncmp(line, "@notify ", 8) == 0)
+         notifications.push_back(cutPlayer(line+8));
+      else
+         tell(eloAlways, "Warning: Ignoring unexpected line '%s' in '%s'", line, path);
+   }
+
+   if (request != "")
+      replays[request].exchanges.push_back({ "", delay, yes });
+
+   free(line);
+   fclose(fp);
+
+   tell(eloAlways, "Loaded %d responses for %d requests and %d notifications from '%s'",
+        count, (int)replays.size(), (int)notifications.size(), path);
+
+   return success;
+}
+
+//***************************************************************************
+// Synthetic Library
+//***************************************************************************
+
+struct Field
+{
+   std::string name;
+   std::string value;
+   int item;                      // first field of a loop element
+};
+
+typedef std::vector<Field> Fields;
+
+void addTrackFields(Fields& fields, int i, int index)
+{
+   fields.push_back({ index >= 0 ? "playlist index" : "id", std::to_string(index >= 0 ? index : 10000+i), yes });
+
+   if (index >= 0)
+      fields.push_back({ "id", std::to_string(10000+i), no });
+
+   fields.push_back({ "title", "Track " + std::to_string(i) + " - the long title of a synthetic song", no });
+   fields.push_back({ "artist", "Artist " + std::to_string(i % opt.artists), no });
+   fields.push_back({ "album", "Album " + std::to_string(i / 10), no });
+   fields.push_back({ "genre", "Genre " + std::to_string(i % 50), no });
+   fields.push_back({ "duration", std::to_string(120 + i % 300), no });
+   fields.push_back({ "year", std::to_string(1960 + i % 60), no });
+   fields.push_back({ "bitrate", "320kbps CBR", no });
+   fields.push_back({ "type", "mp3", no });
+   fields.push_back({ "remote", "0", no });
+
+   // ids of the library tracks, as used by the library index
+
+   if (index < 0)
+   {
+      fields.push_back({ "artist_id", std::to_string(1 + i % opt.artists), no });
+      fields.push_back({ "album_id", std::to_string(1 + i / 10), no });
+      fields.push_back({ "genre_id", std::to_string(1 + i % 50), no });
+      fields.push_back({ "tracknum", std::to_string(1 + i % 10), no });
+   }
+}
+
+//***************************************************************************
+// Synthetic Response
+//  - answers like the LMS, fields are rendered as CLI or JSON by the caller
+//  - returns no for unknown requests (they are just echoed)
+//***************************************************************************
+
+int synthetic(std::vector<std::string>& t, Fields& fields, std::string& loop)
+{
+   int from = t.size() > 2 ? atoi(t[1].c_str()) : 0;
+   int count = t.size() > 2 ? atoi(t[2].c_str()) : 0;
+   int total = 0;
+   const char* name = 0;
+
+   fields.clear();
+   loop = "";
+
+   if (t.empty())
+      return no;
+
+   // scalar queries
+
+   if (t.back() == "?")
+   {
+      std::string value;
+
+      if (t[0] == "version")                                      value = "8.3.1";
+      else if (t.size() > 2 && t[0] == "playlist" && t[1] == "tracks") value = std::to_string(opt.playlistTracks);
+      else if (t.size() > 2 && t[0] == "playlist" && t[1] == "index")  value = std::to_string(state.index);
+      else if (t.size() > 2 && t[0] == "mixer" && t[1] == "volume")    value = std::to_string(state.volume);
+      else if (t.size() > 2 && t[0] == "mixer" && t[1] == "muting")    value = std::to_string(state.muted);
+      else if (t[0] == "mode")                                         value = state.mode;
+      else if (t[0] == "connected")                                    value = "1";
+      else if (t[0] == "power")                                        value = "1";
+      else
+         return no;
+
+      fields.push_back({ "_" + t[t.size()-2], value, no });
+      return yes;
+   }
+
+   if (t[0] == "status")
+   {
+      fields.push_back({ "player_name", "VDR-fake", no });
+      fields.push_back({ "player_connected", "1", no });
+      fields.push_back({ "power", "1", no });
+      fields.push_back({ "mode", state.mode, no });
+      fields.push_back({ "time", "42", no });
+      fields.push_back({ "mixer volume", std::to_string(state.volume), no });
+      fields.push_back({ "playlist repeat", "0", no });
+      fields.push_back({ "playlist shuffle", "0", no });
+      fields.push_back({ "playlist mode", "off", no });
+      fields.push_back({ "playlist_cur_index", std::to_string(state.index), no });
+      fields.push_back({ "playlist_tracks", std::to_string(opt.playlistTracks), no });
+
+      loop = "playlist_loop";
+
+      for (int i = from; i < opt.playlistTracks && i < from + count; i++)
+         addTrackFields(fields, i, i);
+
+      return yes;
+   }
+
+   if (t[0] == "serverstatus")
+   {
+      static time_t lastScan = time(0);
+
+      fields.push_back({ "lastscan", std::to_string(lastScan), no });
+      fields.push_back({ "version", "8.3.1", no });
+      return yes;
+   }
+
+   if (t.size() > 3 && t[1] == "items" && t[0].compare(0, 5, "radio") == 0)
+   {
+      from = atoi(t[2].c_str());
+      count = atoi(t[3].c_str());
+      total = 30;
+      loop = "loop_loop";
+      fields.push_back({ "count", std::to_string(total), no });
+      fields.push_back({ "title", t[0], no });
+
+      for (int i = from; i < total && i < from + count; i++)
+      {
+         fields.push_back({ "id", std::to_string(i) + ".0", yes });
+         fields.push_back({ "name", t[0] + " station " + std::to_string(i), no });
+         fields.push_back({ "isaudio", "1", no });
+         fields.push_back({ "hasitems", "0", no });
+      }
+
+      return yes;
+   }
+
+   if (t[0] == "artists")        { total = opt.artists;       name = "artist"; }
+   else if (t[0] == "albums")    { total = opt.artists * 2;   name = "album"; }
+   else if (t[0] == "genres")    { total = 50;                name = "genre"; }
+   else if (t[0] == "years")     { total = 60;                name = "year"; }
+   else if (t[0] == "playlists") { total = 20;                name = "playlist"; }
+   else if (t[0] == "tracks")    { total = opt.artists * 20;  name = "title"; }
+   else if (t[0] == "radios")    { total = 3;                 name = "name"; }
+   else
+      return no;
+
+   loop = t[0] == "tracks" ? "titles_loop" : t[0] + "_loop";
+   fields.push_back({ "count", std::to_string(total), no });
+
+   for (int i = from; i < total && i < from + count; i++)
+   {
+      if (t[0] == "tracks")
+         addTrackFields(fields, i, na);
+      else if (t[0] == "years")
+         fields.push_back({ "year", std::to_string(1960 + i), yes });
+      else if (t[0] == "radios")
+      {
+         fields.push_back({ "icon", "plugins/icon.png", yes });
+         fields.push_back({ "cmd", "radio" + std::to_string(i), no });
+         fields.push_back({ "name", "Radio " + std::to_string(i), no });
+      }
+      else
+      {
+         std::string key(1, 'A' + (int)((long)i * 26 / total));      // sorted by name
+
+         fields.push_back({ "id", std::to_string(i+1), yes });
+         fields.push_back({ name, key + " " + name + " " + std::to_string(i), no });
+         fields.push_back({ "textkey", key, no });
+      }
+   }
+
+   return yes;
+}
+
+//***************************************************************************
+// Render
+//***************************************************************************
+
+std::string toCli(const std::string& request, const Fields& fields)
+{
+   std::string line = request;
+
+   // scalar query, the '?' is replaced by the value
+
+   if (fields.size() == 1 && fields[0].name[0] == '_' && line.length() && line.back() == '?')
+      return line.substr(0, line.length()-1) + cliEscape(fields[0].value);
+
+   for (const Field& f : fields)
+      line += " " + cliEscape(f.name + ":" + f.value);
+
+   return line;
+}
+
+std::string jsonString(const std::string& str)
+{
+   std::string res = "\"";
+
+   for (unsigned char c : str)
+   {
+      if (c == '"' || c == '\\')
+         res += std::string("\\") + (char)c;
+      else if (c < 0x20)
+      {
+         char tmp[10];
+         sprintf(tmp, "\\u%04x", c);
+         res += tmp;
+      }
+      else
+         res += c;
+   }
+
+   return res + "\"";
+}
+
+std::string jsonValue(const std::string& value)
+{
+   return !value.empty() && isNum(value.c_str()) ? value : jsonString(value);
+}
+
+std::string toJson(const Fields& fields, const std::string& loop)
+{
+   std::string json = "{";
+   int inLoop = no;
+   int first = yes;
+
+   for (const Field& f : fields)
+   {
+      if (f.item)
+      {
+         json += inLoop ? "}," : (first ? "" : ",") + jsonString(loop) + ":[";
+         json += "{";
+         inLoop = yes;
+         first = yes;
+      }
+
+      json += (first ? "" : ",") + jsonString(f.name) + ":" + jsonValue(f.value);
+      first = no;
+   }
+
+   return json + (inLoop ? "}]}" : "}");
+}
+
+//***************************************************************************
+// Answer
+//  - find the response of a CLI request (without player id)
+//***************************************************************************
+
+int answer(const std::string& request, std::string& response, int& delay)
+{
+   std::vector<std::string> tokens;
+   Fields fields;
+   std::string loop;
+
+   delay = opt.delay;
+
+   {
+      std::lock_guard<std::mutex> lock(replayMutex);
+      auto it = replays.find(request);
+
+      if (it != replays.end() && !it->second.exchanges.empty())
+      {
+         Replay& r = it->second;
+         Exchange& e = r.exchanges[r.next++ % r.exchanges.size()];
+
+         delay += e.delay;
+         response = e.response;
+
+         return dropResponse(e.drop) ? done : yes;
+      }
+   }
+
+   tokenize(request, tokens);
+
+   if (synthetic(tokens, fields, loop))
+      response = toCli(request, fields);
+   else
+      response = request;
+
+   return dropResponse(no) ? done : yes;
+}
+
+//***************************************************************************
+// Notify
+//***************************************************************************
+
+void notifyListeners(const std::string& line)
+{
+   std::lock_guard<std::mutex> lock(clientMutex);
+
+   for (Client* c : clients)
+      if (c->listen)
+         c->send(lastPlayer + " " + line);
+}
+
+void notifyBurst()
+{
+   static unsigned int next = 0;
+
+   for (int i = 0; i < opt.burstCount; i++, next++)
+   {
+      if (!notifications.empty())
+         notifyListeners(notifications[next % notifications.size()]);
+      else
+         notifyListeners("playlist newsong " + cliEscape("Track " + std::to_string(next)) + " " + std::to_string(next % opt.playlistTracks));
+   }
+}
+
+// commands are reported to the listeners like the LMS does
+
+void command(std::vector<std::string>& t, const std::string& request)
+{
+   if (t.empty() || t.back() == "?")
+      return;
+
+   if (t[0] == "play" || t[0] == "stop")
+      sprintf(state.mode, "%s", t[0].c_str());
+   else if (t[0] == "pause")
+   {
+      int pause = t.size() > 1 ? atoi(t[1].c_str()) : strcmp(state.mode, "play") == 0;
+      sprintf(state.mode, "%s", pause ? "pause" : "play");
+   }
+   else if (t.size() > 2 && t[0] == "mixer" && t[1] == "volume")
+      state.volume = std::max(0, std::min(100, t[2][0] == '+' || t[2][0] == '-' ? state.volume + atoi(t[2].c_str()) : atoi(t[2].c_str())));
+   else if (t.size() > 2 && t[0] == "mixer" && t[1] == "muting")
+      state.muted = t[2] == "toggle" ? !state.muted : atoi(t[2].c_str());
+   else if (t.size() > 2 && t[0] == "playlist" && t[1] == "index")
+   {
+      state.index = t[2][0] == '+' || t[2][0] == '-' ? state.index + atoi(t[2].c_str()) : atoi(t[2].c_str());
+      state.index = std::max(0, std::min(opt.playlistTracks-1, state.index));
+   }
+   else if (t[0] != "playlist" && t[0] != "playlistcontrol" && t[0] != "time" && t[0] != "power")
+      return;
+
+   notifyListeners(request);
+}
+
+//***************************************************************************
+// CLI Client
+//***************************************************************************
+
+void cliSession(Client* client)
+{
+   char* line;
+   std::string player;
+   std::vector<std::string> tokens;
+
+   while (!doShutdown)
+   {
+      struct pollfd pfd = { client->channel->getHandle(), POLLIN, 0 };
+
+      if (!client->channel->hasLine() && poll(&pfd, 1, 100) <= 0)
+         continue;
+
+      if (!(line = client->channel->readln()))
+         break;
+
+      rTrim(line);
+      std::string request = cutPlayer(line, &player);
+      free(line);
+
+      if (player.empty() || request.empty())
+         continue;
+
+      tell(eloDebug, "<- [%s]", request.c_str());
+
+      lastPlayer = player;
+      tokenize(request, tokens);
+
+      if (tokens.size() > 1 && tokens[0] == "listen")
+         client->listen = tokens[1] == "1";
+
+      std::string response;
+      int delay;
+
+      if (answer(request, response, delay) == done)
+      {
+         tell(eloDetail, "Dropping response to '%s'", request.c_str());
+         continue;
+      }
+
+      if (delay)
+         usleep(delay * 1000);
+
+      if (client->send(player + " " + response) != success)
+         break;
+
+      command(tokens, request);
+   }
+
+   tell(eloDetail, "CLI client disconnected");
+
+   std::lock_guard<std::mutex> lock(clientMutex);
+   clients.remove(client);
+   delete client->channel;
+   delete client;
+}
+
+//***************************************************************************
+// HTTP Client
+//  - GET of covers and POST of JSON-RPC requests (synthetic only)
+//***************************************************************************
+
+// collect the strings/scalars of the 'params' array of a JSON-RPC request
+
+void jsonParams(const char* p, std::vector<std::string>& params)
+{
+   int level = 0;
+
+   params.clear();
+
+   if (!(p = strstr(p, "\"params\"")) || !(p = strchr(p, '[')))
+      return;
+
+   for (; *p; p++)
+   {
+      if (*p == '[')
+         level++;
+      else if (*p == ']' && --level == 0)
+         break;
+      else if (*p == '"')
+      {
+         std::string s;
+
+         for (p++; *p && *p != '"'; p++)
+         {
+            if (*p == '\\' && p[1])
+            {
+               p++;
+
+               if (*p == 'u')
+               {
+                  unsigned int cp = 0;
+                  sscanf(p+1, "%4x", &cp);
+                  p += 4;
+
+                  if (cp < 0x80)
+                     s += (char)cp;
+                  else if (cp < 0x800)
+                     s += std::string() + (char)(0xC0 | (cp >> 6)) + (char)(0x80 | (cp & 0x3F));
+                  else
+                     s += std::string() + (char)(0xE0 | (cp >> 12)) + (char)(0x80 | ((cp >> 6) & 0x3F)) + (char)(0x80 | (cp & 0x3F));
+               }
+               else
+                  s += *p == 'n' ? '\n' : *p == 't' ? '\t' : *p;
+            }
+            else
+               s += *p;
+         }
+
+         params.push_back(s);
+      }
+      else if (isdigit(*p) || *p == '-')
+      {
+         const char* start = p;
+
+         while (p[1] && !strchr(",]} ", p[1]))
+            p++;
+
+         params.push_back(std::string(start, p-start+1));
+      }
+   }
+}
+
+void httpSession(TcpChannel* channel, MemoryStruct* cover)
+{
+   char* line;
+
+   while (!doShutdown)
+   {
+      struct pollfd pfd = { channel->getHandle(), POLLIN, 0 };
+      char method[10+TB] = "";
+      char path[500+TB] = "";
+      int contentLength = 0;
+      int keepAlive = yes;
+      std::string body;
+
+      if (!channel->hasLine() && poll(&pfd, 1, 100) <= 0)
+         continue;
+
+      if (!(line = channel->readln()))
+         break;
+
+      sscanf(line, "%10s %500s", method, path);
+      free(line);
+
+      while ((line = channel->readln()) && *rTrim(line))
+      {
+         if (strncasecmp(line, "Content-Length:", 15) == 0)
+            contentLength = atoi(line+15);
+         else if (strncasecmp(line, "Connection:", 11) == 0 && strcasestr(line+11, "close"))
+            keepAlive = no;
+
+         free(line);
+      }
+
+      if (!line)
+         break;
+
+      free(line);
+
+      if (contentLength > 0)
+      {
+         char* buf = (char*)malloc(contentLength+TB);
+
+         if (channel->readBlock(buf, contentLength) != success)
+         {
+            free(buf);
+            break;
+         }
+
+         buf[contentLength] = 0;
+         body = buf;
+         free(buf);
+      }
+
+      tell(eloDebug, "<- HTTP %s '%s' (%d bytes)", method, path, contentLength);
+
+      std::string header;
+      std::string content;
+
+      if (strcmp(method, "POST") == 0 && strstr(path, "jsonrpc.js"))
+      {
+         std::vector<std::string> params;
+         std::vector<std::string> tokens;
+         std::string request, loop;
+         Fields fields;
+         const char* id = strstr(body.c_str(), "\"id\"");
+
+         jsonParams(body.c_str(), params);
+
+         if (params.size())
+            lastPlayer = cliEscape(params[0]);
+
+         for (size_t i = 1; i < params.size(); i++)
+         {
+            tokens.push_back(params[i]);
+            request += (i > 1 ? " " : "") + cliEscape(params[i]);
+         }
+
+         synthetic(tokens, fields, loop);
+
+         content = "{\"id\":" + std::to_string(id ? atoi(strchr(id, ':')+1) : 0)
+            + ",\"method\":\"slim.request\",\"result\":" + toJson(fields, loop) + "}";
+
+         header = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n";
+
+         if (opt.delay)
+            usleep(opt.delay * 1000);
+
+         if (dropResponse(no))
+         {
+            tell(eloDetail, "Dropping response to '%s'", request.c_str());
+            continue;
+         }
+
+         command(tokens, request);
+      }
+      else if (strcmp(method, "GET") == 0 && cover->memory)
+      {
+         header = "HTTP/1.1 200 OK\r\nContent-Type: image/jpeg\r\n";
+         content = std::string(cover->memory, cover->size);
+      }
+      else
+      {
+         header = "HTTP/1.1 404 Not Found\r\n";
+      }
+
+      header += "Content-Length: " + std::to_string(content.length()) + "\r\n";
+      header += keepAlive ? "\r\n" : "Connection: close\r\n\r\n";
+
+      if (channel->write(header.c_str()) != success
+          || (content.length() && channel->write(content.c_str(), content.length()) != success)
+          || !keepAlive)
+         break;
+   }
+
+   delete channel;
+}
+
+//***************************************************************************
+// Record Session
+//  - proxy to the real LMS, lines of the server without pending request
+//    are notifications of 'listen'
+//***************************************************************************
+
+FILE* recordFp = 0;
+std::mutex recordMutex;
+
+void record(const char* prefix, const char* line)
+{
+   std::lock_guard<std::mutex> lock(recordMutex);
+
+   fprintf(recordFp, "%s%s\n", prefix, line);
+   fflush(recordFp);
+}
+
+void recordSession(TcpChannel* client)
+{
+   TcpChannel server;
+   int pending = 0;
+   char* line;
+
+   if (server.open(opt.lmsPort, opt.lmsHost) != success)
+   {
+      tell(eloAlways, "Error: Opening connection to LMS at '%s:%d' failed", opt.lmsHost, opt.lmsPort);
+      delete client;
+      return;
+   }
+
+   while (!doShutdown)
+   {
+      struct pollfd pfd[2] = { { client->getHandle(), POLLIN, 0 }, { server.getHandle(), POLLIN, 0 } };
+
+      if (!client->hasLine() && !server.hasLine() && poll(pfd, 2, 100) <= 0)
+         continue;
+
+      if (client->hasLine() || pfd[0].revents)
+      {
+         if (!(line = client->readln()))
+            break;
+
+         record("> ", line);
+         server.write(line);
+         server.write("\n");
+         free(line);
+         pending++;
+      }
+
+      if (server.hasLine() || pfd[1].revents)
+      {
+         if (!(line = server.readln()))
+            break;
+
+         record(pending > 0 ? "< " : "@notify ", line);
+         client->write(line);
+         client->write("\n");
+         free(line);
+
+         if (pending > 0)
+            pending--;
+      }
+   }
+
+   server.close();
+   delete client;
+}
+
+//***************************************************************************
+// Signal Handler
+//***************************************************************************
+
+void downF(int signal)
+{
+   tell(eloAlways, "Shutdown triggered with signal %d", signal);
+   doShutdown = yes;
+}
+
+//***************************************************************************
+// Main
+//***************************************************************************
+
+int main(int argc, char** argv)
+{
+   TcpChannel cli, http;
+   TcpChannel* child;
+   MemoryStruct cover;
+   uint64_t lastBurst = cTimeMs::Now();
+
+   logstdout = yes;
+   loglevel = 1;
+
+   if (argc > 1 && (argv[1][0] == '?' || (strcmp(argv[1], "--help") == 0)))
+   {
+      showUsage(argv[0]);
+      return 0;
+   }
+
+   // Parse command line
+
+   for (int i = 1; argv[i]; i++)
+   {
+      if (argv[i][0] != '-' || strlen(argv[i]) != 2 || !argv[i+1])
+      {
+         showUsage(argv[0]);
+         return 1;
+      }
+
+      switch (argv[i][1])
+      {
+         case 'l': loglevel = atoi(argv[++i]);           break;
+         case 'p': opt.cliPort = atoi(argv[++i]);        break;
+         case 'H': opt.httpPort = atoi(argv[++i]);       break;
+         case 'r': opt.replayFile = argv[++i];           break;
+         case 'R': opt.recordFile = argv[++i];           break;
+         case 'h': opt.lmsHost = argv[++i];              break;
+         case 'P': opt.lmsPort = atoi(argv[++i]);        break;
+         case 'c': opt.coverFile = argv[++i];            break;
+         case 't': opt.playlistTracks = atoi(argv[++i]); break;
+         case 'a': opt.artists = std::max(1, atoi(argv[++i])); break;
+         case 'd': opt.delay = atoi(argv[++i]);          break;
+         case 'D': opt.dropRate = atoi(argv[++i]);       break;
+         case 'n': opt.burstCount = atoi(argv[++i]);     break;
+         case 'i': opt.burstInterval = atoi(argv[++i]);  break;
+         case 's': opt.seed = atoi(argv[++i]);           break;
+
+         default:
+         {
+            showUsage(argv[0]);
+            return 1;
+         }
+      }
+   }
+
+   if (opt.recordFile && !opt.lmsHost)
+   {
+      tell(eloAlways, "Error: Record mode needs the host of the real LMS (-h)");
+      return 1;
+   }
+
+   srand(opt.seed);
+   ::signal(SIGINT, downF);
+   ::signal(SIGTERM, downF);
+   ::signal(SIGPIPE, SIG_IGN);
+
+   if (opt.replayFile && loadReplay(opt.replayFile) != success)
+      return 1;
+
+   if (opt.recordFile && !(recordFp = fopen(opt.recordFile, "w")))
+   {
+      tell(eloAlways, "Error: Can't open record file '%s', %m", opt.recordFile);
+      return 1;
+   }
+
+   if (opt.coverFile)
+   {
+      FILE* fp = fopen(opt.coverFile, "r");
+
+      if (!fp)
+      {
+         tell(eloAlways, "Error: Can't open cover '%s', %m", opt.coverFile);
+         return 1;
+      }
+
+      fseek(fp, 0, SEEK_END);
+      cover.size = ftell(fp);
+      cover.memory = (char*)malloc(cover.size);
+      rewind(fp);
+      cover.size = fread(cover.memory, 1, cover.size, fp);
+      fclose(fp);
+   }
+
+   if (cli.openLstn(opt.cliPort) != success || http.openLstn(opt.httpPort) != success)
+   {
+      tell(eloAlways, "Error: Can't listen on port %d/%d", opt.cliPort, opt.httpPort);
+      return 1;
+   }
+
+   tell(eloAlways, "Fake LMS listening on CLI port %d and HTTP port %d%s", opt.cliPort, opt.httpPort,
+        opt.recordFile ? " (recording)" : "");
+
+   while (!doShutdown)
+   {
+      struct pollfd pfd[2] = { { cli.getHandle(), POLLIN, 0 }, { http.getHandle(), POLLIN, 0 } };
+
+      poll(pfd, 2, 10);
+
+      if (cli.listen(child) == success && child)
+      {
+         tell(eloDetail, "CLI client connected");
+
+         if (opt.recordFile)
+            std::thread(recordSession, child).detach();
+         else
+         {
+            Client* client = new Client;
+
+            client->channel = child;
+            client->listen = no;
+
+            std::lock_guard<std::mutex> lock(clientMutex);
+            clients.push_back(client);
+            std::thread(cliSession, client).detach();
+         }
+      }
+
+      if (http.listen(child) == success && child)
+         std::thread(httpSession, child, &cover).detach();
+
+      if (opt.burstCount && cTimeMs::Now() - lastBurst >= (uint64_t)opt.burstInterval)
+      {
+         lastBurst = cTimeMs::Now();
+         notifyBurst();
+      }
+   }
+
+   usleep(200000);   // give the sessions the chance to finish
+
+   if (recordFp)
+      fclose(recordFp);
+
+   return 0;
+}
@@ -5,11 +5,88 @@
  *
  */
 
+#include <algorithm>
+
 #include "squeezebox.h"
+#include "config.h"
+#include "libindex.h"
+#include "lmcmanager.h"
 #include "menu.h"
 
 //***************************************************************************
-// Manu Base
+// Menu Items
+//***************************************************************************
+
+void cMenuItems::clear()
+{
+   items.clear();
+   arena.clear();
+   arena.push_back(0);       // offset 0 is the empty string
+}
+
+void cMenuItems::resize(int n)
+{
+   Item placeholder;
+
+   memset(&placeholder, 0, sizeof(placeholder));
+   items.resize(n, placeholder);
+}
+
+int cMenuItems::add(const char* text, const char* id, const char* command,
+                    int hasItems, int isAudio, const char* textKey)
+{
+   items.push_back(make(text, id, command, hasItems, isAudio, textKey));
+
+   return items.size() - 1;
+}
+
+int cMenuItems::set(int i, const LmcCom::ListItem* item)
+{
+   if (i < 0)
+      return fail;
+
+   if (i >= count())
+      resize(i+1);
+
+   if (items[i].loaded)
+      return done;            // don't fill the arena twice
+
+   items[i] = make(item->content.c_str(), item->id.c_str(), item->command.c_str(),
+                   item->hasItems, item->isAudio, item->textKey.c_str());
+
+   return success;
+}
+
+cMenuItems::Item cMenuItems::make(const char* text, const char* id, const char* command,
+                                  int hasItems, int isAudio, const char* textKey)
+{
+   Item item;
+
+   item.text = store(text);
+   item.id = store(id);
+   item.command = store(command);
+   item.textKey = store(textKey);
+   item.hasItems = hasItems ? 1 : 0;
+   item.isAudio = isAudio ? 1 : 0;
+   item.loaded = 1;
+
+   return item;
+}
+
+uint32_t cMenuItems::store(const char* s)
+{
+   uint32_t offset = arena.size();
+
+   if (!s || !*s)
+      return 0;
+
+   arena.insert(arena.end(), s, s + strlen(s) + 1);
+
+   return offset;
+}
+
+//***************************************************************************
+// Menu Base
 //***************************************************************************
 
 cMenuBase* cMenuBase::activeMenu = 0;
@@ -25,8 +102,6 @@ cMenuBase::cMenuBase(const char* aTitle)
    activeMenu = this;
    visibleItems = 0;
    parent = 0;
-
-   Clear();
 }
 
 cMenuBase::~cMenuBase()
@@ -61,7 +136,7 @@ int cMenuBase::ProcessKey(int key)
          if (current > 0)         
             current--; 
          else if (Setup.MenuScrollWrap)
-            current = Count()-1;
+            current = getCount()-1;
 
          return done;        
       }
@@ -69,7 +144,7 @@ int cMenuBase::ProcessKey(int key)
       case kDown|k_Repeat:
       case kDown: 
       {
-         if (current < Count()-1) 
+         if (current < getCount()-1) 
             current++; 
          else if (Setup.MenuScrollWrap)
             current = 0;
@@ -83,7 +158,7 @@ int cMenuBase::ProcessKey(int key)
          if (current > 0)
             current = max(current-visibleItems, 0);
          else if (Setup.MenuScrollWrap)
-            current = Count()-1;
+            current = getCount()-1;
 
          return done;
       }
@@ -91,8 +166,8 @@ int cMenuBase::ProcessKey(int key)
       case kRight|k_Repeat:
       case kRight:
       {
-         if (current < Count()-1)
-            current = min(current+visibleItems, Count()-1);
+         if (current < getCount()-1)
+            current = min(current+visibleItems, getCount()-1);
          else if (Setup.MenuScrollWrap)
             current = 0;
 
@@ -127,60 +202,347 @@ cSubMenu::Query cSubMenu::queries[] =
    { LmcCom::rqtUnknown }
 };
 
+//***************************************************************************
+// Menu Worker
+//***************************************************************************
+
+std::list<cMenuWorker*> cMenuWorker::orphans;
+cMutex cMenuWorker::orphansMutex;
+
+cMenuWorker::cMenuWorker(const char* description)
+   : cThread(description)
+{
+   attached = yes;
+   LmcManager::acquire();     // the connection has to outlive an orphan
+}
+
+cMenuWorker::~cMenuWorker()
+{
+   LmcManager::release();
+}
+
+void cMenuWorker::Action()
+{
+   cMutexLock lock(&menuMutex);
+
+   if (attached)
+      work();
+}
+
+void cMenuWorker::waitWakeup(int timeout)
+{
+   unlockMenu();
+   waitCondition.Wait(timeout);
+   relockMenu();
+}
+
+//***************************************************************************
+// Release
+//  - called by the menu on close, the worker doesn't touch it afterwards
+//***************************************************************************
+
+void cMenuWorker::release(cMenuWorker* worker)
+{
+   if (!worker)
+      return;
+
+   worker->Cancel(-1);
+   worker->waitCondition.Signal();
+
+   worker->menuMutex.Lock();         // at most until the running query is done
+   worker->attached = no;
+   worker->menuMutex.Unlock();
+
+   orphansMutex.Lock();
+   orphans.push_back(worker);
+   orphansMutex.Unlock();
+
+   reap();
+}
+
+//***************************************************************************
+// Reap
+//  - deletes the orphans which are done, all of them if wait is set
+//***************************************************************************
+
+void cMenuWorker::reap(int wait)
+{
+   cMutexLock lock(&orphansMutex);
+   std::list<cMenuWorker*>::iterator it = orphans.begin();
+
+   while (it != orphans.end())
+   {
+      while (wait && (*it)->Active())
+         cCondWait::SleepMs(10);
+
+      if ((*it)->Active())
+      {
+         ++it;
+         continue;
+      }
+
+      delete *it;
+      it = orphans.erase(it);
+   }
+}
+
+//***************************************************************************
+// Menu Loader
+//***************************************************************************
+
+cMenuLoader::cMenuLoader(cSubMenu* aMenu, LmcCom* aLmc, LmcCom::RangeQueryType aQueryType,
+                         const char* aCommand, LmcCom::Parameters* aFilters, int aMaxElements)
+   : cMenuWorker("squeezebox-menu")
+{
+   menu = aMenu;
+   lmc = aLmc;
+   queryType = aQueryType;
+   command = aCommand ? aCommand : "";
+   maxElements = aMaxElements;
+
+   if (aFilters)
+      filters = *aFilters;
+}
+
+//***************************************************************************
+// Work
+//***************************************************************************
+
+void cMenuLoader::work()
+{
+   LmcCom::RangeList list;
+   int total = 0;
+
+   // library levels from the local index, the LMS only if it can't answer
+
+   if (cfg.libraryIndex && cLibraryIndex::query(queryType, 0, maxElements, &filters, &list, total) == success)
+   {
+      menu->setItems(0, &list, total);
+      menu->loadDone(success);
+      return;
+   }
+
+   if (menu->isWindowed())
+      loadWindows();
+   else
+      loadAll();
+}
+
+//***************************************************************************
+// Load All
+//  - page by page until the end of the list
+//  - to be sorted the pages are merged and the menu gets the complete
+//    list at the end, items don't move while the user scrolls
+//***************************************************************************
+
+void cMenuLoader::loadAll()
+{
+   LmcCom::RangeList list;
+   LmcCom::RangeList sorted;
+   int status = success;
+   int from = 0;
+   int total = 0;
+
+   while (Running() && from < maxElements)
+   {
+      int count = min(from ? (int)pageSize : (int)firstPageSize, maxElements - from);
+
+      unlockMenu();
+      status = lmc->queryRange(queryType, from, count, &list, total, command.c_str(), &filters);
+
+      if (!relockMenu() || status != success)
+         break;
+
+      int received = list.size();
+
+      if (cfg.sortMenus)
+         LmcCom::mergeList(&sorted, &list);
+      else
+         menu->addPage(&list, total);
+
+      from += count;
+
+      if (received < count || (total && from >= total))
+         break;
+   }
+
+   if (cfg.sortMenus && Running())
+      menu->addPage(&sorted, total);
+
+   if (!Running())
+   {
+      tell(eloDetail, "Loading of menu canceled after %d items", from);
+      return;
+   }
+
+   menu->loadDone(status);
+}
+
+//***************************************************************************
+// Load Windows
+//  - the first window tells the total, the others are loaded as wanted
+//    by the menu (scrolled to) until it is closed
+//***************************************************************************
+
+void cMenuLoader::loadWindows()
+{
+   int status = loadWindow(0);
+
+   if (!Running())
+      return;
+
+   menu->loadDone(status);
+
+   if (status != success)
+      return;
+
+   while (Running())
+   {
+      std::string key;
+      int w = menu->wantedWindow(key);
+
+      if (!key.empty())
+         seek(key);
+      else if (w != na)
+         loadWindow(w);
+      else
+         waitWakeup(1000);
+   }
+}
+
+int cMenuLoader::loadWindow(int w)
+{
+   LmcCom::RangeList list;
+   int total = 0;
+   int status;
+
+   unlockMenu();
+   status = lmc->queryRange(queryType, windowStart(w), windowSize(w), &list, total, command.c_str(), &filters);
+
+   if (!relockMenu())
+      return status;
+
+   if (status != success)
+   {
+      tell(eloAlways, "Loading of window %d (items %d-%d) failed", w, windowStart(w), windowStart(w)+windowSize(w)-1);
+      list.clear();            // mark it loaded anyway, no endless retry
+   }
+
+   menu->setItems(windowStart(w), &list, total);
+
+   return status;
+}
+
+//***************************************************************************
+// Seek
+//  - the LMS has no query for the offset of a letter, the window is
+//    located by a binary search over the first items of the windows
+//    (single item queries if not yet loaded), then only it is fetched
+//***************************************************************************
+
+int cMenuLoader::seek(const std::string& key)
+{
+   int count = menu->getCount();
+   int lo = 0;
+   int hi = count ? windowOf(count-1) : 0;
+   int probes = 0;
+
+   // the last window starting before the key
+
+   while (lo < hi && Running())
+   {
+      int mid = (lo + hi + 1) / 2;
+      std::string first;
+
+      if (firstKey(windowStart(mid), first) != success)
+         return fail;
+
+      probes++;
+
+      if (LmcCom::compareTextKeys(first.c_str(), key.c_str()) < 0)
+         lo = mid;
+      else
+         hi = mid - 1;
+   }
+
+   if (!Running())
+      return done;
+
+   if (!menu->isWindowLoaded(lo))
+      loadWindow(lo);
+
+   if (!Running())
+      return done;
+
+   tell(eloDebug, "Jump to '%s' located in window %d after %d probes", key.c_str(), lo, probes);
+   menu->seekDone(key, lo);
+
+   return success;
+}
+
+int cMenuLoader::firstKey(int index, std::string& key)
+{
+   LmcCom::RangeList list;
+   int total = 0;
+
+   if (menu->getTextKey(index, key) == success)
+      return success;
+
+   unlockMenu();
+   int status = lmc->queryRange(queryType, index, 1, &list, total, command.c_str(), &filters);
+
+   if (!relockMenu() || status != success || list.empty())
+      return fail;
+
+   key = list.front().textKey;
+   menu->setItems(index, &list, total);
+
+   return success;
+}
+
 //***************************************************************************
 // Menu
 //***************************************************************************
 
-cSubMenu::cSubMenu(cMenuBase* aParent, const char* title, LmcCom* aLmc, 
+cSubMenu::cSubMenu(cMenuBase* aParent, const char* title, LmcCom* aLmc,
                    LmcCom::RangeQueryType aQueryType, LmcCom::Parameters* aFilters)
    : cMenuSqueeze(title, aLmc)
 {
-   static int maxElements = 50000;
-   LmcCom::RangeList list;
-   int total;
-
    parent = aParent;
    lmc = aLmc;
    queryType = aQueryType;
+   loader = 0;
+   loading = no;
+   changed = no;
+   helpDone = no;
+   total = 0;
+   jumpTo = na;
+   lastDigit = na;
+   tapIndex = 0;
 
-   Clear();
+   windowed = RangeCache::isCacheable(queryType);
+   jumpable = queryType == LmcCom::rqtGenres || queryType == LmcCom::rqtArtists
+      || queryType == LmcCom::rqtAlbums;
+
+   items.clear();
 
    if (queryType == LmcCom::rqtRadioApps)
    {
-      cSubMenuItem* item = (cSubMenuItem*)parent->Get(parent->getCurrent());   
-
       if (parent)
       {
-         char flt[500+TB];
+         char flt[500+TB] = "";
+         int p = parent->getCurrent();
 
+         command = parent->getItems()->command(p);
          filters.clear();
 
          if (toIdTag(queryType) != LmcTag::tUnknown)   // tIsAudio !!!
          {
-            snprintf(flt, 500, "%s:%s", LmcTag::toName(toIdTag(queryType)), item->getItem()->id.c_str());
+            snprintf(flt, 500, "%s:%s", LmcTag::toName(toIdTag(queryType)), parent->getItems()->id(p));
             filters.push_back(flt);
          }
 
-         if (item && item->getItem())
-         {
-            tell(eloDebug, "Radio command: '%s' with '%s'", item->getItem()->command.c_str(), flt);
-            
-            if (lmc && lmc->queryRange(queryType, 0, maxElements, &list, total, item->getItem()->command.c_str(), &filters) == success)
-            {
-               LmcCom::RangeList::iterator it;
-               
-               for (it = list.begin(); it != list.end(); ++it)
-               {
-                  if ((*it).command == "search")    // not implemented
-                     continue;
-
-                  if ((*it).command.empty())
-                     (*it).command = item->getItem()->command;
-
-                  Add(new cSubMenuItem(&(*it)));
-               }
-            }
-         }
+         tell(eloDebug, "Radio command: '%s' with '%s'", command.c_str(), flt);
       }
    }
    else
@@ -190,171 +552,479 @@ cSubMenu::cSubMenu(cMenuBase* aParent, const char* title, LmcCom* aLmc,
 
       if (queryType == LmcCom::rqtNewMusic)
          filters.push_back("sort:new");
-
-      if (lmc && lmc->queryRange(queryType, 0, maxElements, &list, total, "", &filters) == success)
-      {
-         LmcCom::RangeList::iterator it;
-         
-         for (it = list.begin(); it != list.end(); ++it)
-            Add(new cSubMenuItem(&(*it)));
-         
-         if (total > maxElements)
-            tell(eloAlways, "Warning: %d more, only maxElements supported", total-maxElements);
-      }
    }
 
-   // #TODO, change help info with current item while scrolling
+   setHelp(tr("Close"), 0, 0, 0);
 
-   cSubMenuItem* item = (cSubMenuItem*)Get(0);
+   // the items are queried in the background
 
-   if (item && item->getItem()->isAudio)
-      setHelp(tr("Close"), tr("Insert"), tr("Append"), tr("Play"));
-   else
-      setHelp(tr("Close"), 0, 0, 0);
+   if (lmc && (queryType != LmcCom::rqtRadioApps || parent))
+   {
+      loading = yes;
+      loader = new cMenuLoader(this, lmc, queryType, command.c_str(), &filters, maxElements);
+      loader->Start();
+   }
 }
 
 cSubMenu::~cSubMenu() 
 { 
+   cMenuWorker::release(loader);     // finishes a running query detached
 }
 
 //***************************************************************************
-// Process Key
+// Add Page (loader thread)
 //***************************************************************************
 
-int cSubMenu::ProcessKey(int key)
+void cSubMenu::addPage(LmcCom::RangeList* list, int aTotal)
 {
-   int state;
-   char flt[500];
-
-   if ((state = cMenuBase::ProcessKey(key)) != ignore)
-      return state;
-
-   cSubMenuItem* item = (cSubMenuItem*)Get(getCurrent());
+   cMutexLock lock(&mutex);
+   LmcCom::RangeList::iterator it;
 
-   if (key == kOk)
+   for (it = list->begin(); it != list->end(); ++it)
    {
-      if (toSubLevelQuery(queryType) != LmcCom::rqtUnknown)
+      if (queryType == LmcCom::rqtRadioApps)
       {
-         char* subTitle;
-         LmcCom::Parameters pars = filters;
-         int addSub = queryType == LmcCom::rqtRadioApps ? item->getItem()->hasItems : yes;
+         if ((*it).command == "search")    // not implemented
+            continue;
 
-         if (addSub)
-         {
-            asprintf(&subTitle, "%s / %s ", Title(), item->getItem()->content.c_str());
-            sprintf(flt, "%s:%s", LmcTag::toName(toIdTag(queryType)), 
-                    queryType == LmcCom::rqtYears ? item->getItem()->content.c_str() : item->getItem()->id.c_str());
-            pars.push_back(flt);
-            
-            AddSubMenu(new cSubMenu(this, subTitle, lmc, toSubLevelQuery(queryType), &pars));
-            free(subTitle);
-         }
+         if ((*it).command.empty())
+            (*it).command = command;
       }
-      
-      return done;
+
+      items.add(&(*it));
    }
 
-   else if (item->getItem()->isAudio)
-   {
-      LmcCom::Parameters pars;
+   total = aTotal;
+   changed = yes;
+}
+
+void cSubMenu::loadDone(int status)
+{
+   cMutexLock lock(&mutex);
+
+   if (status != success)
+      tell(eloAlways, "Loading of menu '%s' failed after %d items", Title(), items.count());
+   else if (total > maxElements)
+      tell(eloAlways, "Warning: %d more, only maxElements supported", total-maxElements);
+
+   // the first level of the radio apps into the radio cache, the same
+   //  page the sub menu will ask for
 
-      switch (key)
+   if (status == success && queryType == LmcCom::rqtRadios)
+   {
+      for (int i = 0; i < items.count(); i++)
       {
-         case kGreen:
-         {
-            if (queryType < LmcCom::rqtRadios)
-            {
-               pars = filters;
-               pars.push_back("cmd:insert");
-               sprintf(flt, "%s:%s", LmcTag::toName(toIdTag(queryType)), item->getItem()->id.c_str());
-               pars.push_back(flt);
-               lmc->execute("playlistcontrol", &pars);
-            }
-            else
-            {
-               sprintf(flt, "%s:%s", LmcTag::toName(toIdTag(queryType)), item->getItem()->id.c_str());
-               pars.push_back(flt);
-               sprintf(flt, "%s playlist insert", item->getItem()->command.c_str());
-               lmc->execute(flt, &pars);
-            }
-            
-            return done;
-         }
+         RadioCache::Request request;
+         char flt[500+TB];
 
-         case kYellow:
-         {
-            if (queryType < LmcCom::rqtRadios)
-            {
-               pars = filters;            
-               pars.push_back("cmd:add");
-               sprintf(flt, "%s:%s", LmcTag::toName(toIdTag(queryType)), item->getItem()->id.c_str());
-               pars.push_back(flt);
-               lmc->execute("playlistcontrol", &pars);
-            }
-            else
-            {
-               sprintf(flt, "%s:%s", LmcTag::toName(toIdTag(queryType)), item->getItem()->id.c_str());
-               pars.push_back(flt);
-               sprintf(flt, "%s playlist add", item->getItem()->command.c_str());
-               lmc->execute(flt, &pars);
-            }
-            
-            return done;
-         }
-  
+         snprintf(flt, 500, "%s:%s", LmcTag::toName(toIdTag(LmcCom::rqtRadioApps)), items.id(i));
 
-         case kBlue:         
-         {     
-            if (queryType < LmcCom::rqtRadios)
-            {
-               pars = filters;
-               pars.push_back("cmd:load");
-               sprintf(flt, "%s:%s", LmcTag::toName(toIdTag(queryType)), item->getItem()->id.c_str());
-               pars.push_back(flt);
-               lmc->execute("playlistcontrol", &pars);
-            }
-            else
-            {
-               sprintf(flt, "%s:%s", LmcTag::toName(toIdTag(queryType)), item->getItem()->id.c_str());
-               pars.push_back(flt);
-               sprintf(flt, "%s playlist play", item->getItem()->command.c_str());
-               lmc->execute(flt, &pars);
-            }
-            
-            return done;
-         }
-         
-         default: 
-            return ignore;
+         request.queryType = LmcCom::rqtRadioApps;
+         request.from = 0;
+         request.count = min((int)cMenuLoader::firstPageSize, (int)maxElements);
+         request.special = items.command(i);
+         request.pars.push_back(flt);
+         request.key = RadioCache::toKey(request.queryType, request.from, request.count,
+                                         request.special.c_str(), &request.pars);
+
+         RadioCache::prefetch(&request);
       }
    }
-   else
-   {
-      if (key == kGreen || key == kYellow || key == kBlue)
-         return done;
-   }
 
-   return ignore;
+   loading = no;
+   changed = yes;
 }
 
 //***************************************************************************
-// Menu
+// Set Items (loader thread)
+//  - a window (or the whole list), the first call creates placeholders
+//    for all items so the menu shows the total at once
+//  - changes of the text key between loaded neighbours go to the jump index
 //***************************************************************************
 
-cMenuSqueeze::cMenuSqueeze(const char* aTitle, LmcCom* aLmc)
-   : cMenuBase(aTitle)
+void cSubMenu::setItems(int from, LmcCom::RangeList* list, int aTotal)
 {
-   lmc = aLmc;
+   cMutexLock lock(&mutex);
+   LmcCom::RangeList::iterator it;
+   int count = min(max(aTotal, from + (int)list->size()), (int)maxElements);
+   int i = from;
 
-   Add(new cMenuItem(tr("Artists")));
-   Add(new cMenuItem(tr("Albums")));
-   Add(new cMenuItem(tr("Genres")));
-   Add(new cMenuItem(tr("Years")));
-   Add(new cMenuItem(tr("Play random tracks")));
-   Add(new cMenuItem(tr("Playlists")));
-   Add(new cMenuItem(tr("Radio")));
-   Add(new cMenuItem(tr("Favorites")));
-   Add(new cMenuItem(tr("New Music")));
+   if (count > items.count())
+   {
+      items.resize(count);
+      windows.resize(cMenuLoader::windowOf(count-1) + 1, no);
+   }
+
+   for (it = list->begin(); it != list->end() && i < count; ++it, i++)
+      items.set(i, &(*it));
+
+   for (int w = cMenuLoader::windowOf(from); w < (int)windows.size() && cMenuLoader::windowStart(w) < from + (int)list->size(); w++)
+   {
+      int end = min(cMenuLoader::windowStart(w) + cMenuLoader::windowSize(w), count);
+
+      if (cMenuLoader::windowStart(w) >= from && end <= from + (int)list->size())
+         windows[w] = yes;
+   }
+
+   if (from == 0 && items.isLoaded(0))
+      jumpIndex[items.textKey(0)] = 0;
+
+   for (int j = max(from, 1); j <= i && j < count; j++)
+   {
+      if (items.isLoaded(j) && items.isLoaded(j-1) && strcmp(items.textKey(j), items.textKey(j-1)) != 0)
+      {
+         auto jt = jumpIndex.find(items.textKey(j));
+
+         if (jt == jumpIndex.end() || jt->second > j)
+            jumpIndex[items.textKey(j)] = j;
+      }
+   }
+
+   total = aTotal;
+   changed = yes;
+}
+
+int cSubMenu::isWindowLoaded(int w)
+{
+   cMutexLock lock(&mutex);
+
+   return w >= 0 && w < (int)windows.size() && windows[w];
+}
+
+int cSubMenu::getTextKey(int index, std::string& key)
+{
+   cMutexLock lock(&mutex);
+
+   if (!items.isLoaded(index))
+      return fail;
+
+   key = items.textKey(index);
+
+   return success;
+}
+
+//***************************************************************************
+// Wanted Window (loader thread)
+//  - a pending jump or the first missing window around the current item,
+//    one page before and after it are loaded in advance
+//***************************************************************************
+
+int cSubMenu::wantedWindow(std::string& key)
+{
+   cMutexLock lock(&mutex);
+   int wanted = na;
+   int cur = getCurrent();
+   int page = max(getVisibleItems(), 1);
+
+   key = seekKey;
+   seekKey = "";
+
+   if (key.empty() && items.count())
+   {
+      int at[] = { cur, cur + page, cur - page };
+
+      for (int i = 0; i < 3 && wanted == na; i++)
+      {
+         int w = cMenuLoader::windowOf(max(0, min(at[i], items.count()-1)));
+
+         if (w < (int)windows.size() && !windows[w])
+            wanted = w;
+      }
+   }
+
+   int busy = !key.empty() || wanted != na;
+
+   if (loading != busy)
+   {
+      loading = busy;
+      changed = yes;
+   }
+
+   return wanted;
+}
+
+void cSubMenu::seekDone(const std::string& key, int w)
+{
+   cMutexLock lock(&mutex);
+   int start = cMenuLoader::windowStart(w);
+   int end = min(start + cMenuLoader::windowSize(w), items.count());
+
+   jumpTo = min(end, items.count()-1);      // behind the window if it has no such key
+
+   for (int i = start; i < end; i++)
+   {
+      if (items.isLoaded(i) && LmcCom::compareTextKeys(items.textKey(i), key.c_str()) >= 0)
+      {
+         jumpTo = i;
+         break;
+      }
+   }
+
+   changed = yes;
+}
+
+//***************************************************************************
+// Jump Key
+//  - the same key within the timeout cycles through its letters
+//***************************************************************************
+
+void cSubMenu::jumpKey(int digit)
+{
+   static const char* keyLetters[] =
+   {
+      "0", "1", "ABC", "DEF", "GHI", "JKL", "MNO", "PQRS", "TUV", "WXYZ"
+   };
+
+   if (digit == lastDigit && !tapTimer.TimedOut())
+      tapIndex = (tapIndex + 1) % strlen(keyLetters[digit]);
+   else
+      tapIndex = 0;
+
+   lastDigit = digit;
+   tapTimer.Set(multiTapTimeout);
+
+   jump(std::string(1, keyLetters[digit][tapIndex]));
+}
+
+//***************************************************************************
+// Jump
+//  - to the first item with a text key not below the key, directly if
+//    the jump index knows it, otherwise the loader has to locate it
+//***************************************************************************
+
+void cSubMenu::jump(const std::string& key)
+{
+   auto it = jumpIndex.lower_bound(key);
+
+   if (it != jumpIndex.end())
+   {
+      int i = it->second;
+
+      if (i == 0 || (items.isLoaded(i-1) && LmcCom::compareTextKeys(items.textKey(i-1), key.c_str()) < 0))
+      {
+         setCurrent(i);
+
+         if (loader)
+            loader->wakeup();
+
+         return;
+      }
+   }
+
+   if (std::find(windows.begin(), windows.end(), no) == windows.end())
+   {
+      setCurrent(items.count()-1);      // all loaded, nothing behind the key
+      return;
+   }
+
+   if (loader)
+   {
+      seekKey = key;
+      loader->wakeup();
+   }
+}
+
+//***************************************************************************
+// Refresh (OSD thread)
+//  - the help is set here and not by the loader since the OSD reads it
+//***************************************************************************
+
+int cSubMenu::refresh()
+{
+   cMutexLock lock(&mutex);
+
+   if (!changed)
+      return no;
+
+   changed = no;
+
+   if (jumpTo != na)
+   {
+      setCurrent(jumpTo);
+      jumpTo = na;
+
+      if (loader)
+         loader->wakeup();      // the items behind a key at the end of a window
+   }
+
+   // #TODO, change help info with current item while scrolling
+
+   if (!helpDone && items.count())
+   {
+      if (items.isAudio(0))
+         setHelp(tr("Close"), tr("Insert"), tr("Append"), tr("Play"));
+
+      helpDone = yes;
+   }
+
+   return yes;
+}
+
+//***************************************************************************
+// Process Key
+//***************************************************************************
+
+int cSubMenu::ProcessKey(int key)
+{
+   int state;
+   char flt[500];
+
+   if (key >= k0 && key <= k9 && jumpable)
+   {
+      cMutexLock lock(&mutex);
+
+      if (items.isLoaded(0) && *items.textKey(0))     // LMS without textkey support
+         jumpKey(key - k0);
+
+      return done;
+   }
+
+   if ((state = cMenuBase::ProcessKey(key)) != ignore)
+   {
+      if (loader)
+         loader->wakeup();
+
+      return state;
+   }
+
+   std::string itemId;
+   std::string itemCommand;
+
+   // the item is copied, the LMS commands are sent without the lock
+   // which the OSD thread needs for drawing
+
+   {
+      cMutexLock lock(&mutex);
+      int cur = getCurrent();
+
+      if (!getCount())
+         return ignore;
+
+      if (!items.isLoaded(cur))
+         return done;              // placeholder, not yet loaded
+
+      if (key == kOk)
+      {
+         if (toSubLevelQuery(queryType) != LmcCom::rqtUnknown)
+         {
+            char* subTitle;
+            LmcCom::Parameters pars = filters;
+            int addSub = queryType == LmcCom::rqtRadioApps ? items.hasItems(cur) : yes;
+
+            if (addSub)
+            {
+               asprintf(&subTitle, "%s / %s ", Title(), items.text(cur));
+               sprintf(flt, "%s:%s", LmcTag::toName(toIdTag(queryType)), 
+                       queryType == LmcCom::rqtYears ? items.text(cur) : items.id(cur));
+               pars.push_back(flt);
+            
+               AddSubMenu(new cSubMenu(this, subTitle, lmc, toSubLevelQuery(queryType), &pars));
+               free(subTitle);
+            }
+         }
+      
+         return done;
+      }
+
+      if (!items.isAudio(cur))
+         return key == kGreen || key == kYellow || key == kBlue ? done : ignore;
+
+      itemId = items.id(cur);
+      itemCommand = items.command(cur);
+   }
+
+   LmcCom::Parameters pars;
+
+   switch (key)
+   {
+      case kGreen:
+      {
+         if (queryType < LmcCom::rqtRadios)
+         {
+            pars = filters;
+            pars.push_back("cmd:insert");
+            sprintf(flt, "%s:%s", LmcTag::toName(toIdTag(queryType)), itemId.c_str());
+            pars.push_back(flt);
+            lmc->execute("playlistcontrol", &pars);
+         }
+         else
+         {
+            sprintf(flt, "%s:%s", LmcTag::toName(toIdTag(queryType)), itemId.c_str());
+            pars.push_back(flt);
+            sprintf(flt, "%s playlist insert", itemCommand.c_str());
+            lmc->execute(flt, &pars);
+         }
+         
+         return done;
+      }
+
+      case kYellow:
+      {
+         if (queryType < LmcCom::rqtRadios)
+         {
+            pars = filters;            
+            pars.push_back("cmd:add");
+            sprintf(flt, "%s:%s", LmcTag::toName(toIdTag(queryType)), itemId.c_str());
+            pars.push_back(flt);
+            lmc->execute("playlistcontrol", &pars);
+         }
+         else
+         {
+            sprintf(flt, "%s:%s", LmcTag::toName(toIdTag(queryType)), itemId.c_str());
+            pars.push_back(flt);
+            sprintf(flt, "%s playlist add", itemCommand.c_str());
+            lmc->execute(flt, &pars);
+         }
+         
+         return done;
+      }
+  
+
+      case kBlue:         
+      {     
+         if (queryType < LmcCom::rqtRadios)
+         {
+            pars = filters;
+            pars.push_back("cmd:load");
+            sprintf(flt, "%s:%s", LmcTag::toName(toIdTag(queryType)), itemId.c_str());
+            pars.push_back(flt);
+            lmc->execute("playlistcontrol", &pars);
+         }
+         else
+         {
+            sprintf(flt, "%s:%s", LmcTag::toName(toIdTag(queryType)), itemId.c_str());
+            pars.push_back(flt);
+            sprintf(flt, "%s playlist play", itemCommand.c_str());
+            lmc->execute(flt, &pars);
+         }
+         
+         return done;
+      }
+      
+      default: 
+         return ignore;
+   }
+}
+
+//***************************************************************************
+// Menu
+//***************************************************************************
+
+cMenuSqueeze::cMenuSqueeze(const char* aTitle, LmcCom* aLmc)
+   : cMenuBase(aTitle)
+{
+   lmc = aLmc;
+
+   items.add(tr("Artists"));
+   items.add(tr("Albums"));
+   items.add(tr("Genres"));
+   items.add(tr("Years"));
+   items.add(tr("Play random tracks"));
+   items.add(tr("Playlists"));
+   items.add(tr("Radio"));
+   items.add(tr("Favorites"));
+   items.add(tr("New Music"));
+   items.add(tr("Search"));
 
    setHelp(tr("Close"), 0, 0, 0);
 }
@@ -370,7 +1040,7 @@ int cMenuSqueeze::ProcessKey(int key)
    if ((state = cMenuBase::ProcessKey(key)) != ignore)
       return state;
 
-   cMenuItem* item = (cMenuItem*)Get(getCurrent());
+   const char* text = getItemTextAt(getCurrent());
 
    switch (key)
    {
@@ -382,15 +1052,16 @@ int cMenuSqueeze::ProcessKey(int key)
       {
          switch (getCurrent())
          {
-            case 0: return AddSubMenu(new cSubMenu(this, item->getText(), lmc, LmcCom::rqtArtists));
-            case 1: return AddSubMenu(new cSubMenu(this, item->getText(), lmc, LmcCom::rqtAlbums));
-            case 2: return AddSubMenu(new cSubMenu(this, item->getText(), lmc, LmcCom::rqtGenres));
-            case 3: return AddSubMenu(new cSubMenu(this, item->getText(), lmc, LmcCom::rqtYears));
+            case 0: return AddSubMenu(new cSubMenu(this, text, lmc, LmcCom::rqtArtists));
+            case 1: return AddSubMenu(new cSubMenu(this, text, lmc, LmcCom::rqtAlbums));
+            case 2: return AddSubMenu(new cSubMenu(this, text, lmc, LmcCom::rqtGenres));
+            case 3: return AddSubMenu(new cSubMenu(this, text, lmc, LmcCom::rqtYears));
             case 4: lmc->randomTracks(); return done;
-            case 5: return AddSubMenu(new cSubMenu(this, item->getText(), lmc, LmcCom::rqtPlaylists));
-            case 6: return AddSubMenu(new cSubMenu(this, item->getText(), lmc, LmcCom::rqtRadios));
-            case 7: return AddSubMenu(new cSubMenu(this, item->getText(), lmc, LmcCom::rqtFavorites));
-            case 8: return AddSubMenu(new cSubMenu(this, item->getText(), lmc, LmcCom::rqtNewMusic));
+            case 5: return AddSubMenu(new cSubMenu(this, text, lmc, LmcCom::rqtPlaylists));
+            case 6: return AddSubMenu(new cSubMenu(this, text, lmc, LmcCom::rqtRadios));
+            case 7: return AddSubMenu(new cSubMenu(this, text, lmc, LmcCom::rqtFavorites));
+            case 8: return AddSubMenu(new cSubMenu(this, text, lmc, LmcCom::rqtNewMusic));
+            case 9: return AddSubMenu(new cSearchMenu(this, lmc));
          }
       }
 
@@ -400,3 +1071,242 @@ int cMenuSqueeze::ProcessKey(int key)
 
    return ignore;
 }
+
+//***************************************************************************
+// Search Worker
+//***************************************************************************
+
+cSearchWorker::cSearchWorker(cSearchMenu* aMenu, LmcCom* aLmc)
+   : cMenuWorker("squeezebox-search")
+{
+   menu = aMenu;
+   lmc = aLmc;
+}
+
+void cSearchWorker::work()
+{
+   while (Running())
+   {
+      LmcCom::RangeList list;
+      std::string term;
+      int total;
+
+      if (menu->takeTerm(term) != success)
+      {
+         waitWakeup(1000);
+         continue;
+      }
+
+      if (!term.empty())
+      {
+         if (!cfg.libraryIndex || cLibraryIndex::search(term.c_str(), cSearchMenu::maxResults, &list, total) != success)
+         {
+            unlockMenu();
+            lmc->search(term.c_str(), cSearchMenu::maxResults, &list);
+
+            if (!relockMenu())
+               break;
+         }
+      }
+
+      menu->setResults(term, &list);
+   }
+}
+
+//***************************************************************************
+// Search Menu
+//***************************************************************************
+
+cSearchMenu::cSearchMenu(cMenuBase* aParent, LmcCom* aLmc)
+   : cMenuSqueeze(tr("Search"), aLmc)
+{
+   parent = aParent;
+   lmc = aLmc;
+   pending = no;
+   searching = no;
+   changed = yes;
+   lastDigit = na;
+
+   items.clear();
+   setHelp(tr("Close"), 0, 0, 0);
+
+   worker = new cSearchWorker(this, lmc);
+   worker->Start();
+}
+
+cSearchMenu::~cSearchMenu()
+{
+   cMenuWorker::release(worker);     // finishes a running search detached
+}
+
+//***************************************************************************
+// Type Key
+//  - the same key within the timeout cycles through its characters
+//***************************************************************************
+
+void cSearchMenu::typeKey(int digit)
+{
+   static const char* keyChars[] =
+   {
+      " 0", "1.-'", "abc2", "def3", "ghi4", "jkl5", "mno6", "pqrs7", "tuv8", "wxyz9"
+   };
+
+   const char* chars = keyChars[digit];
+
+   if (digit == lastDigit && !tapTimer.TimedOut() && !term.empty())
+   {
+      const char* p = strchr(chars, term[term.length()-1]);
+      term[term.length()-1] = p && p[1] ? p[1] : chars[0];
+   }
+   else
+      term += chars[0];
+
+   lastDigit = digit;
+   tapTimer.Set(multiTapTimeout);
+}
+
+void cSearchMenu::termChanged()
+{
+   pending = yes;
+   searching = yes;
+   changed = yes;
+   setCurrent(0);
+
+   worker->wakeup();
+}
+
+int cSearchMenu::takeTerm(std::string& aTerm)
+{
+   cMutexLock lock(&mutex);
+
+   if (!pending)
+      return fail;
+
+   aTerm = term;
+   pending = no;
+
+   return success;
+}
+
+//***************************************************************************
+// Set Results (worker thread)
+//***************************************************************************
+
+void cSearchMenu::setResults(const std::string& aTerm, LmcCom::RangeList* list)
+{
+   cMutexLock lock(&mutex);
+   LmcCom::RangeList::iterator it;
+
+   if (aTerm != term)
+      return;                 // typed on meanwhile, the next one is pending
+
+   items.clear();
+
+   for (it = list->begin(); it != list->end(); ++it)
+   {
+      const char* type = (*it).command == "artist_id" ? tr("Artist")
+         : (*it).command == "album_id" ? tr("Album") : tr("Track");
+
+      items.add(cString::sprintf("%s: %s", type, (*it).content.c_str()),
+                (*it).id.c_str(), (*it).command.c_str(), (*it).hasItems, (*it).isAudio);
+   }
+
+   searching = pending;
+   changed = yes;
+}
+
+//***************************************************************************
+// Refresh (OSD thread)
+//***************************************************************************
+
+int cSearchMenu::refresh()
+{
+   cMutexLock lock(&mutex);
+
+   if (!changed)
+      return no;
+
+   changed = no;
+   setTitle(cString::sprintf("%s: %s_", tr("Search"), term.c_str()));
+
+   if (items.count())
+      setHelp(tr("Close"), tr("Insert"), tr("Append"), tr("Play"));
+   else
+      setHelp(tr("Close"), 0, 0, 0);
+
+   return yes;
+}
+
+//***************************************************************************
+// Process Key
+//***************************************************************************
+
+int cSearchMenu::ProcessKey(int key)
+{
+   int state;
+   LmcCom::Parameters pars;
+   char flt[500];
+
+   {
+      cMutexLock lock(&mutex);
+
+      if (key >= k0 && key <= k9)
+      {
+         typeKey(key - k0);
+         termChanged();
+         return done;
+      }
+
+      if (key == kBack && !term.empty())
+      {
+         term.erase(term.length()-1);
+         lastDigit = na;
+         termChanged();
+         return done;
+      }
+   }
+
+   if ((state = cMenuBase::ProcessKey(key)) != ignore)
+      return state;
+
+   {
+      cMutexLock lock(&mutex);
+      int cur = getCurrent();
+
+      if (!getCount())
+         return ignore;
+
+      snprintf(flt, 500, "%s:%s", items.command(cur), items.id(cur));
+      pars.push_back(flt);
+
+      // artists and albums open their level, tracks are played
+
+      if (key == kOk && items.hasItems(cur))
+      {
+         char* subTitle;
+         int isArtist = strcmp(items.command(cur), "artist_id") == 0;
+
+         asprintf(&subTitle, "%s / %s ", tr("Search"), items.text(cur));
+         AddSubMenu(new cSubMenu(this, subTitle, lmc, isArtist ? LmcCom::rqtAlbums : LmcCom::rqtTracks, &pars));
+         free(subTitle);
+
+         return done;
+      }
+   }
+
+   // sent without the lock, the OSD thread needs it for drawing
+
+   switch (key)
+   {
+      case kGreen:  pars.push_front("cmd:insert"); break;
+      case kYellow: pars.push_front("cmd:add");    break;
+      case kOk:
+      case kBlue:   pars.push_front("cmd:load");   break;
+
+      default: return ignore;
+   }
+
+   lmc->execute("playlistcontrol", &pars);
+
+   return done;
+}
@@ -5,58 +5,82 @@
  *
  */
 
+#include <stdint.h>
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include <vdr/thread.h>
+
 #include "lmctag.h"
 
 //***************************************************************************
-// Menu Item
+// Menu Items
+//  - index addressable, the strings of all items are stored in one arena
+//    so even a list of 50000 artists needs only a few allocations
+//  - the returned strings are valid until the next add() or clear()
+//  - resize() adds placeholders which are set() when their page arrives
 //***************************************************************************
 
-class cMenuItem : public cListObject
+class cMenuItems
 {
    public:
 
-      cMenuItem(const char* aText) { text = strdup(aText); }
-      ~cMenuItem()                 { free(text); }
-
-      const char* getText()        { return text; }
-
-   private:
-      
-      char* text;
-};
+      cMenuItems()                          { clear(); }
 
-//***************************************************************************
-// Sub Menu Item
-//***************************************************************************
+      void clear();
+      void resize(int n);
+      int add(const char* text, const char* id = "", const char* command = "",
+              int hasItems = no, int isAudio = no, const char* textKey = "");
+      int add(const LmcCom::ListItem* item)
+      {
+         return add(item->content.c_str(), item->id.c_str(), item->command.c_str(),
+                    item->hasItems, item->isAudio, item->textKey.c_str());
+      }
+      int set(int i, const LmcCom::ListItem* item);
 
-class cSubMenuItem : public cMenuItem
-{
-   public:
-   
-      cSubMenuItem(LmcCom::ListItem* aItem) : cMenuItem(aItem->content.c_str()) 
-      { item = *aItem; }
+      int count() const                     { return items.size(); }
+      const char* text(int i) const         { return valid(i) ? &arena[items[i].text] : ""; }
+      const char* id(int i) const           { return valid(i) ? &arena[items[i].id] : ""; }
+      const char* command(int i) const      { return valid(i) ? &arena[items[i].command] : ""; }
+      int hasItems(int i) const             { return valid(i) && items[i].hasItems; }
+      int isAudio(int i) const              { return valid(i) && items[i].isAudio; }
+      const char* textKey(int i) const      { return valid(i) ? &arena[items[i].textKey] : ""; }
+      int isLoaded(int i) const             { return valid(i) && items[i].loaded; }
 
-      virtual ~cSubMenuItem()
-      { }
+   private:
 
-      const char* getText()              { return item.content.c_str(); }
-      const LmcCom::ListItem* getItem()  { return &item; }
+      struct Item
+      {
+         uint32_t text;          // offsets in the arena
+         uint32_t id;
+         uint32_t command;
+         uint32_t textKey;
+         uint8_t hasItems;
+         uint8_t isAudio;
+         uint8_t loaded;         // no for a placeholder
+      };
 
-   protected:
+      int valid(int i) const                { return i >= 0 && i < (int)items.size(); }
+      uint32_t store(const char* s);
+      Item make(const char* text, const char* id, const char* command,
+                int hasItems, int isAudio, const char* textKey);
 
-      LmcCom::ListItem item;
+      std::vector<Item> items;
+      std::vector<char> arena;
 };
 
 //***************************************************************************
 // Menu Base
 //***************************************************************************
 
-class cMenuBase : public cList<cMenuItem>
+class cMenuBase
 {
    public:
 
       cMenuBase(const char* aTitle);
-      ~cMenuBase();
+      virtual ~cMenuBase();
 
       const char* Title()                { return title; }
       int AddSubMenu(cMenuBase* subMenu) {  activeMenu->setVisibleItems(visibleItems); return done; };
@@ -64,12 +88,19 @@ class cMenuBase : public cList<cMenuItem>
 
       static cMenuBase* getActive()      { return activeMenu; }
 
-      int getCount()                     { return Count(); }
+      int getCount()                     { cMutexLock lock(&mutex); return items.count(); }
       int getCurrent()                   { return current; }
-      const char* getItemTextAt(int i)   { return Get(i)->getText(); }
+      const char* getItemTextAt(int i)   { return items.isLoaded(i) ? items.text(i) : "..."; }   // hold getMutex() while using it
+      const cMenuItems* getItems()       { return &items; }
+      cMutex* getMutex()                 { return &mutex; }
+
+      virtual int isLoading()            { return no; }
+      virtual int refresh()              { return no; }    // called by the OSD thread, yes if changed
 
       void setHelp(const char* r, const char* g, const char* y, const char* b);
+      void setTitle(const char* t)  { free(title); title = strdup(t); }
       void setVisibleItems(int n) { visibleItems = n; }
+      int getVisibleItems()       { return visibleItems; }
 
       const char* Red()     { return red ? red : ""; }
       const char* Green()   { return green ? green : ""; }
@@ -78,7 +109,11 @@ class cMenuBase : public cList<cMenuItem>
 
    protected:
 
+      void setCurrent(int c)             { current = c; }
+
       cMenuBase* parent;
+      cMenuItems items;
+      cMutex mutex;                      // the items may be filled by a loader thread
 
    private:
 
@@ -110,6 +145,90 @@ class cMenuSqueeze : public cMenuBase
       LmcCom* lmc;
 };
 
+//***************************************************************************
+// Menu Worker
+//  - background thread of a menu, never cancelled hard since it may be
+//    inside a query on the shared LMS connection
+//  - work() runs with menuMutex held, it is released only for queries
+//    and waits, the menu is valid as long as it's held and Running()
+//  - a closed menu only detaches its worker, the orphan finishes the
+//    current query and is deleted by reap() once it is no more active
+//***************************************************************************
+
+class cMenuWorker : public cThread
+{
+   public:
+
+      cMenuWorker(const char* description);
+      virtual ~cMenuWorker();
+
+      void wakeup()      { waitCondition.Signal(); }
+
+      static void release(cMenuWorker* worker);
+      static void reap(int wait = no);
+
+   protected:
+
+      virtual void Action();
+      virtual void work() = 0;
+
+      void unlockMenu()  { menuMutex.Unlock(); }
+      int relockMenu()   { menuMutex.Lock(); return Running(); }
+      void waitWakeup(int timeout);
+
+      cMutex menuMutex;
+      cCondWait waitCondition;
+      int attached;
+
+      static std::list<cMenuWorker*> orphans;
+      static cMutex orphansMutex;
+};
+
+//***************************************************************************
+// Menu Loader
+//  - queries the items of a sub menu page by page in the background, the
+//    menu is shown at once and filled while the pages arrive
+//  - the library levels are loaded by windows, the first one only tells
+//    the total and the others are fetched when scrolled or jumped to
+//  - stops after the current page if the menu is closed before
+//***************************************************************************
+
+class cSubMenu;
+
+class cMenuLoader : public cMenuWorker
+{
+   public:
+
+      enum Misc
+      {
+         firstPageSize = 100,       // small, to fill the screen fast
+         pageSize      = 500
+      };
+
+      cMenuLoader(cSubMenu* aMenu, LmcCom* aLmc, LmcCom::RangeQueryType aQueryType,
+                  const char* aCommand, LmcCom::Parameters* aFilters, int aMaxElements);
+
+      static int windowStart(int w)  { return w ? firstPageSize + (w-1) * pageSize : 0; }
+      static int windowSize(int w)   { return w ? pageSize : firstPageSize; }
+      static int windowOf(int i)     { return i < firstPageSize ? 0 : 1 + (i-firstPageSize) / pageSize; }
+
+   protected:
+
+      virtual void work();
+      void loadAll();
+      void loadWindows();
+      int loadWindow(int w);
+      int seek(const std::string& key);
+      int firstKey(int index, std::string& key);
+
+      cSubMenu* menu;
+      LmcCom* lmc;
+      LmcCom::RangeQueryType queryType;
+      std::string command;
+      LmcCom::Parameters filters;
+      int maxElements;
+};
+
 //***************************************************************************
 // Sub Menu
 //***************************************************************************
@@ -118,11 +237,32 @@ class cSubMenu : public cMenuSqueeze
 {
    public:
 
+      enum Misc
+      {
+         maxElements     = 50000,
+         multiTapTimeout = 1000      // [ms]
+      };
+
       cSubMenu(cMenuBase* aParent, const char* title, LmcCom* aLmc, 
                LmcCom::RangeQueryType aQueryType, LmcCom::Parameters* aFilters = 0);
       virtual ~cSubMenu();
       virtual int ProcessKey(int key);
 
+      virtual int isLoading()            { return loading; }
+      virtual int refresh();
+
+      void addPage(LmcCom::RangeList* list, int aTotal);
+      void loadDone(int status);
+
+      // windowed loading (loader thread)
+
+      int isWindowed()                   { return windowed; }
+      int isWindowLoaded(int w);
+      void setItems(int from, LmcCom::RangeList* list, int aTotal);
+      int wantedWindow(std::string& key);
+      int getTextKey(int index, std::string& key);
+      void seekDone(const std::string& key, int w);
+
    protected:
 
       struct Query
@@ -134,9 +274,31 @@ class cSubMenu : public cMenuSqueeze
       
    private:
 
+      void jumpKey(int digit);
+      void jump(const std::string& key);
+
       LmcCom::Parameters filters;
       LmcCom* lmc;
       LmcCom::RangeQueryType queryType;
+      std::string command;                    // of the radio apps
+      cMenuLoader* loader;
+      int loading;
+      int changed;
+      int helpDone;
+      int total;
+
+      // jump by the first letter (textkey of the LMS), the number keys
+      //  select the letter like on a phone keypad
+
+      int windowed;
+      int jumpable;                           // sorted by name
+      std::vector<char> windows;              // loaded
+      std::map<std::string,int,LmcCom::TextKeyLess> jumpIndex;    // textkey -> first item, as far as loaded
+      std::string seekKey;                    // to be located by the loader
+      int jumpTo;
+      int lastDigit;
+      int tapIndex;
+      cTimeMs tapTimer;
 
       // static stuff
 
@@ -160,3 +322,62 @@ class cSubMenu : public cMenuSqueeze
          return LmcCom::rqtUnknown;
       }
 };
+
+//***************************************************************************
+// Search Menu
+//  - type ahead by the number keys (multi tap like a phone keypad), Back
+//    deletes the last character
+//  - the worker searches the library index (trigrams) or, as long as it
+//    isn't built, the LMS and always only for the latest term
+//***************************************************************************
+
+class cSearchMenu;
+
+class cSearchWorker : public cMenuWorker
+{
+   public:
+
+      cSearchWorker(cSearchMenu* aMenu, LmcCom* aLmc);
+
+   protected:
+
+      virtual void work();
+
+      cSearchMenu* menu;
+      LmcCom* lmc;
+};
+
+class cSearchMenu : public cMenuSqueeze
+{
+   public:
+
+      enum Misc
+      {
+         maxResults      = 200,
+         multiTapTimeout = 1000      // [ms]
+      };
+
+      cSearchMenu(cMenuBase* aParent, LmcCom* aLmc);
+      virtual ~cSearchMenu();
+      virtual int ProcessKey(int key);
+
+      virtual int isLoading()            { return searching; }
+      virtual int refresh();
+
+      int takeTerm(std::string& aTerm);
+      void setResults(const std::string& aTerm, LmcCom::RangeList* list);
+
+   private:
+
+      void typeKey(int digit);
+      void termChanged();
+
+      LmcCom* lmc;
+      cSearchWorker* worker;
+      std::string term;
+      int pending;                  // term not yet searched
+      int searching;
+      int changed;
+      int lastDigit;
+      cTimeMs tapTimer;
+};
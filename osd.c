@@ -7,12 +7,16 @@
 
 #include <string.h>
 
+#include <functional>
+
 #include <vdr/keys.h>
 #include <vdr/status.h>
 
 #include "lib/common.h"
+#include "lib/stats.h"
 
 #include "lmccom.h"
+#include "lmcmanager.h"
 #include "config.h"
 #include "osd.h"
 #include "helpers.h"
@@ -59,7 +63,9 @@ cSqueezeOsd::cSqueezeOsd(const char* aResDir)
    lastScrollAt = time(0);
    plItemSpace = 10;
    plItems = 0;
+   plFirstPageDrawn = no;
    plItemHeight = 0;
+   plPortFirst = 0;
    resDir = strdup(aResDir);
    buttonLevel = 0;
    menu = 0;
@@ -105,14 +111,10 @@ cSqueezeOsd::cSqueezeOsd(const char* aResDir)
 
    osd2web = 0;
 
-   lmc = new LmcCom(cfg.mac);
+   lmc = LmcManager::acquire();      // shared with the control and the menus
+   refreshSnapshot();
+   actionThread = 0;
    imgLoader = new cImageMagickWrapper();
-
-   if (lmc->open(cfg.lmcHost, cfg.lmcPort) != success)
-   {
-      tell(eloAlways, "Opening connection to LMC server at '%s:%d' failed",
-           cfg.lmcHost, cfg.lmcPort);
-   }
 }
 
 cSqueezeOsd::~cSqueezeOsd()
@@ -121,8 +123,9 @@ cSqueezeOsd::~cSqueezeOsd()
    exit();
 
    delete statusMonitor;
-   delete lmc;
    delete imgLoader;
+
+   LmcManager::release();
    delete osd;
 
    free(resDir);
@@ -135,7 +138,13 @@ cSqueezeOsd::~cSqueezeOsd()
 void cSqueezeOsd::stop()
 {
    loopActive = no;
-   Cancel(3);             // wait up to 3 seconds for thread was stopping
+   Cancel(-1);
+
+   // no hard cancel, the loop may be inside a query holding the lock
+   // of the shared connection
+
+   while (Active())
+      cCondWait::SleepMs(10);
 }
 
 void cSqueezeOsd::view()
@@ -208,18 +217,28 @@ int cSqueezeOsd::init()
       plItemSpace = ((plHeight-2*border) - (plItems * fontPl->Height()*2)) / plItems;
       plItemHeight = fontPl->Height()*2 + plItemSpace;
 
+      plRows.assign(plPortPages * plItems, PlaylistRow());     // the new pixmap is empty
+      plPortFirst = 0;
+
       menuItemHeight = fontStd->Height() + menuItemSpace;        // first aproach
       menuItems = (menuHeight-2*border) / menuItemHeight;
       menuItemSpace = ((menuHeight-2*border) - menuItems * menuItemHeight) / menuItems;
       menuItemHeight = fontStd->Height() + menuItemSpace;        // recalc
       visibleMenuItems = (menuHeight-2*border) / menuItemHeight;
 
+      // rendered rows of a former OSD session are reused if the layout is the same
+
+      cRowCache::setLayout(*cString::sprintf("%s:%d:%d:%d:%d", vdrFont->FontName(), fontPl->Height(),
+                                             fontStd->Height(), plItemHeight, menuItemHeight));
+      cImageMagickWrapper::setGeometry(*cString::sprintf("%dx%d:%d", cOsd::OsdWidth(), cOsd::OsdHeight(), plItemHeight));
+
       tell(eloDebug, "calculated %d items with a space of %d, hight is %d",
            plItems, plItemSpace, (plHeight-2*border));
 
       res += createBox(pixmapCover, border, border, coverAreaWidth, coverAreaHeight, clrBlack, clrWhite, 15);
       res += createBox(pixmapInfo, leftX, border, width, ifoHeight, clrBox, clrBoxBlend, 15);
-      res += createBox(pixmapPlaylist, leftX, plY, width, plHeight, clrBox, clrBoxBlend, 15);
+      res += createBox(pixmapPlaylist, leftX, plY, width, plHeight, clrBox, clrBoxBlend, 15,
+                       plPortPages * plItems * plItemHeight);
       res += createBox(pixmapPlCurrent, leftX, plY, width, plItemHeight, clrBox, clrWhite, 15);
       res += createBox(pixmapStatus, leftX, stY, width, stHeight, clrBox, clrBoxBlend, 15);
 
@@ -298,7 +317,7 @@ int cSqueezeOsd::exit()
 //***************************************************************************
 
 int cSqueezeOsd::createBox(cPixmap* pixmap[], int x, int y, int width, int height,
-                           tColor color, tColor blend, int radius)
+                           tColor color, tColor blend, int radius, int drawPortHeight)
 {
    if (!osd)
       return fail;
@@ -323,9 +342,12 @@ int cSqueezeOsd::createBox(cPixmap* pixmap[], int x, int y, int width, int heigh
       DrawRoundedCorners(pixmap[pmBack], radius, 0, 0, width, height);
    }
 
-   // front/text pixmap
+   // front/text pixmap, optional with a higher draw port
+
+   cRect viewPort(x+2*border, y+border, width-4*border, height-2*border);
+   cRect drawPort = drawPortHeight ? cRect(0, 0, viewPort.Width(), drawPortHeight) : cRect::Null;
 
-   if (!(pixmap[pmText] = osd->CreatePixmap(2, cRect(x+2*border, y+border, width-4*border, height-2*border))))
+   if (!(pixmap[pmText] = osd->CreatePixmap(2, viewPort, drawPort)))
       return fail;
 
    pixmap[pmText]->Fill(clrTransparent);
@@ -400,7 +422,7 @@ int cSqueezeOsd::ProcessKey(int key)
       case kDown|k_Repeat:
       case kDown:
       {
-         if (plCurrent < lmc->getTrackCount()-1)
+         if (plCurrent < lmc->getSnapshot()->getTrackCount()-1)
             plCurrent++;
 
          plUserAction = yes;
@@ -413,8 +435,10 @@ int cSqueezeOsd::ProcessKey(int key)
       case kRight|k_Repeat:
       case kRight:
       {
-         if (plCurrent < lmc->getTrackCount()-1)
-            plCurrent = min(plCurrent+plItems, lmc->getTrackCount()-1);
+         int count = lmc->getSnapshot()->getTrackCount();
+
+         if (plCurrent < count-1)
+            plCurrent = min(plCurrent+plItems, count-1);
 
          plUserAction = yes;
          lastScrollAt = time(0);
@@ -438,7 +462,7 @@ int cSqueezeOsd::ProcessKey(int key)
 
       case kOk:
       {
-         if (plCurrent > na && plCurrent < lmc->getTrackCount())
+         if (plCurrent > na && plCurrent < lmc->getSnapshot()->getTrackCount())
          {
             plUserAction = no;
             lmc->track(plCurrent);
@@ -462,15 +486,33 @@ void cSqueezeOsd::Action()
    int changesPending = yes;
    int fullDraw;
    uint64_t lastDraw = 0;
+   uint64_t notifiedAt = 0;
 
    osd2web = cPluginManager::GetPlugin("osd2web");
    loopActive = yes;
-   currentState = lmc->getPlayerState();
 
-   lmc->update();
+   // take over the notifications from the watcher, if it prewarmed the
+   // state the first frame is drawn without waiting for the LMS
+
+   LmcManager::suspendWatcher();
+   actionThread = cThread::ThreadId();
+   lmc->setTrackListener(this);        // the watcher doesn't update() anymore
    lmc->startNotify();
+   refreshSnapshot();
+
+   if (!snapshot->version)
+   {
+      lmc->update();
+      refreshSnapshot();
+   }
 
-   if (strcmp(currentState->mode, "play") != 0)
+   // a restored state (state cache) is drawn first and confirmed afterwards,
+   // its mode is the one of the last shutdown, start playing by the
+   // confirmed one
+
+   int reconcile = snapshot->restored;
+
+   if (!reconcile && strcmp(currentState->mode, "play") != 0)
       lmc->play();
 
    while (loopActive && Running())
@@ -497,6 +539,10 @@ void cSqueezeOsd::Action()
       // check for notification with 50ms timeout
 
       changesPending = lmc->checkNotify(0) == success;
+      refreshSnapshot();
+
+      if (changesPending && !notifiedAt)
+         notifiedAt = lmc->getNotifiedAt();
       tell(eloDebug2, "looping %d ... (%d) (%d)", count++, changesPending, forceNextDraw);
 
       usleep(10000);   // #TODO use mutex wait condition instead
@@ -520,7 +566,7 @@ void cSqueezeOsd::Action()
 
       if (osd && cTimeMs::Now() >= nextScrollStep)
       {
-         TrackInfo* currentTrack = lmc->getCurrentTrack();
+         const TrackInfo* currentTrack = snapshot->getCurrentTrack();
 
          if (!isEmpty(currentTrack->lyrics))
          {
@@ -529,6 +575,11 @@ void cSqueezeOsd::Action()
          }
       }
 
+      // sub menu filled in the background
+
+      if (menu && cMenuBase::getActive() && cMenuBase::getActive()->refresh())
+         forceMenuDraw = yes;
+
       // check force
 
       fullDraw = forceNextDraw || changesPending;
@@ -563,11 +614,81 @@ void cSqueezeOsd::Action()
          forceMenuDraw = no;
          lastDraw = cTimeMs::Now();
 
-         osd->Flush();
+         {
+            static LatencyStat* stat = Statistics::get("osd.flush");
+            LatencyProbe probe(stat);
+            osd->Flush();
+         }
+
+         // time from receiving the notification until it's visible on the screen
+
+         if (notifiedAt)
+         {
+            static LatencyStat* stat = Statistics::get("notify.toScreen");
+
+            stat->add(Statistics::usNow() - notifiedAt);
+            notifiedAt = 0;
+         }
+
+         if (reconcile)
+         {
+            reconcile = no;
+            lmc->update();
+            refreshSnapshot();
+            forceNextDraw = yes;
+
+            if (strcmp(currentState->mode, "play") != 0)
+               lmc->play();
+         }
       }
    }
 
-   lmc->stopNotify();
+   lmc->setTrackListener(0);
+
+   if (LmcManager::resumeWatcher() != success)
+      lmc->stopNotify();      // nobody else is listening
+}
+
+//***************************************************************************
+// Tracks Arrived
+//  - called by lmc->update() while a large playlist is still arriving,
+//    draw the visible page as soon as it's complete
+//  - registered only while the watcher is suspended, other threads
+//    calling update() (control, menus) are ignored, the drawing and the
+//    image caches belong to our thread
+//***************************************************************************
+
+void cSqueezeOsd::tracksArrived(const PlaylistSnapshot* building)
+{
+   if (cThread::ThreadId() != actionThread)
+      return;
+
+   int count = building->getTrackCount();
+
+   if (count == 1)
+      plFirstPageDrawn = no;
+
+   if (plFirstPageDrawn || !osd || menu || !plItems)
+      return;
+
+   if (count < max(0, building->state.plIndex-2) + plItems)
+      return;
+
+   drawPlaylist(building);
+   osd->Flush();
+   plFirstPageDrawn = yes;
+}
+
+//***************************************************************************
+// Refresh Snapshot
+//  - take the last state published by lmc, the former snapshot is
+//    released when no other reader holds it
+//***************************************************************************
+
+void cSqueezeOsd::refreshSnapshot()
+{
+   snapshot = lmc->getSnapshot();
+   currentState = &snapshot->state;
 }
 
 //***************************************************************************
@@ -576,6 +697,8 @@ void cSqueezeOsd::Action()
 
 int cSqueezeOsd::drawOsd()
 {
+   static LatencyStat* stat = Statistics::get("osd.full");
+   LatencyProbe probe(stat);
    tell(eloDebug, "Draw OSD");
 
    // set alpha to force redraw of background boxes
@@ -615,6 +738,8 @@ int cSqueezeOsd::drawOsd()
 
 int cSqueezeOsd::drawMenu()
 {
+   static LatencyStat* stat = Statistics::get("osd.menu");
+   LatencyProbe probe(stat);
    int x = 0;
    int y = 0;
    cMenuBase* active = menu ? menu->getActive() : 0;
@@ -629,13 +754,20 @@ int cSqueezeOsd::drawMenu()
 
    // title
 
-   pixmapMenuTitle[pmText]->DrawText(cPoint(0, 0), active->Title(),
+   pixmapMenuTitle[pmText]->DrawText(cPoint(0, 0),
+                                     active->isLoading() ? cString::sprintf("%s ...", active->Title()) : cString(active->Title()),
                                      clrWhite, clrTransparent, fontStd);
 
-   // visible menu items
+   // visible menu items, the loader may add items meanwhile
 
-   int current = menu->getActive()->getCurrent();
-   int count = menu->getActive()->getCount();
+   cMutexLock lock(active->getMutex());
+
+   int current = active->getCurrent();
+   int count = active->getCount();
+
+   if (!count && active->isLoading())
+      pixmapMenu[pmText]->DrawText(cPoint(x, y), tr("Loading ..."),
+                                   clrWhite, clrTransparent, fontStd, pixmapMenu[pmText]->ViewPort().Width());
 
    // adjust first Visible;
 
@@ -655,9 +787,7 @@ int cSqueezeOsd::drawMenu()
                                                       pixmapMenuCurrent[pmBack]->ViewPort().Height()));
       }
 
-      pixmapMenu[pmText]->DrawText(cPoint(x, y),
-                                   cString::sprintf("%s", menu->getActive()->getItemTextAt(i)),
-                                   clrWhite, clrTransparent, fontStd, pixmapMenu[pmText]->ViewPort().Width());
+      drawMenuRow(active->getItemTextAt(i), x, y);
 
       y += menuItemHeight;
    }
@@ -674,13 +804,45 @@ int cSqueezeOsd::drawMenu()
    return done;
 }
 
+//***************************************************************************
+// Draw Menu Row
+//  - from the row cache, rendered aside on a miss
+//***************************************************************************
+
+int cSqueezeOsd::drawMenuRow(const char* text, int x, int y)
+{
+   int width = pixmapMenu[pmText]->ViewPort().Width() - x;
+   std::string key = *cString::sprintf("mn:%d:%s", width, text);
+   const cImage* cached = cRowCache::get(key);
+
+   if (cached)
+   {
+      pixmapMenu[pmText]->DrawImage(cPoint(x, y), *cached);
+      return done;
+   }
+
+   cPixmapMemory pixmap(0, cRect(0, 0, width, menuItemHeight));
+
+   pixmap.Fill(clrTransparent);
+   pixmap.DrawText(cPoint(0, 0), text, clrWhite, clrTransparent, fontStd, width);
+
+   cImage image(cSize(width, menuItemHeight), (const tColor*)pixmap.Data());
+
+   pixmapMenu[pmText]->DrawImage(cPoint(x, y), image);
+   cRowCache::put(key, image);
+
+   return done;
+}
+
 //***************************************************************************
 // Draw Info Box
 //***************************************************************************
 
 int cSqueezeOsd::drawInfoBox()
 {
-   TrackInfo* currentTrack = lmc->getCurrentTrack();
+   static LatencyStat* stat = Statistics::get("osd.infobox");
+   LatencyProbe probe(stat);
+   const TrackInfo* currentTrack = snapshot->getCurrentTrack();
 
    sendInfoBox(currentTrack);
 
@@ -754,12 +916,14 @@ int cSqueezeOsd::drawInfoBox()
 
 int cSqueezeOsd::drawProgress(int y)
 {
+   static LatencyStat* stat = Statistics::get("osd.progress");
+   LatencyProbe probe(stat);
    static int yLast = 0;
    static int lastTime = 0;
 
    int time;
    int barHeight = fontStd->Height();
-   TrackInfo* currentTrack = lmc->getCurrentTrack();
+   const TrackInfo* currentTrack = snapshot->getCurrentTrack();
    const cRect rect = pixmapInfo[pmText]->ViewPort();
 
    if (y != na)  yLast = y;
@@ -814,98 +978,220 @@ int cSqueezeOsd::drawProgress(int y)
 
 //***************************************************************************
 // Draw Playlist
+//  - only rows which show something else than before are drawn, moving
+//    the cursor costs the two rows changing their color and scrolling
+//    the rows coming into view
 //***************************************************************************
 
-int cSqueezeOsd::drawPlaylist()
+int cSqueezeOsd::drawPlaylist(const PlaylistSnapshot* s)
 {
+   static LatencyStat* stat = Statistics::get("osd.playlist");
+   LatencyProbe probe(stat);
    static int lastCount = na;
 
-   if (!osd)
+   if (!osd || plRows.empty())
       return fail;
 
-   int y = 0;
-   cImage* imgSpeaker = 0;
-   int imgWH = pixmapPlCurrent[pmText]->ViewPort().Height() / 3.0 * 2.0;
-   int coverHeight = pixmapPlCurrent[pmText]->ViewPort().Height();
-   int imgX = pixmapPlCurrent[pmText]->ViewPort().Width() - imgWH;
-   int imgY = imgWH / 4;
+   if (!s)
+      s = snapshot.get();
 
    cPixmap::Lock();
 
-   pixmapPlaylist[pmText]->Fill(clrTransparent);       // clear box
-
    // set focus to current if no user interactivity or if count changed
 
-   if (!plUserAction || lmc->getTrackCount() != lastCount)
+   if (!plUserAction || s->getTrackCount() != lastCount)
    {
-      plCurrent = currentState->plIndex;
-      plTop = max(0, currentState->plIndex-2);
+      plCurrent = s->state.plIndex;
+      plTop = max(0, s->state.plIndex-2);
    }
 
-   lastCount = lmc->getTrackCount();
+   lastCount = s->getTrackCount();
 
    if (plCurrent < plTop)
       plTop = plCurrent;
    else if (plCurrent >= plTop + plItems)
       plTop = plCurrent - plItems +1;
 
-   int cnt = 0;
+   // visible page outside of the draw port, move it (a page above plTop)
+
+   if (plTop < plPortFirst || plTop + plItems > plPortFirst + (int)plRows.size())
+      movePlaylistPort(max(0, plTop - plItems));
+
+   for (int i = plTop; i < plTop + plItems; i++)
+      drawPlaylistRow(s, i);
 
-   for (int i = plTop; i < lmc->getTrackCount() && cnt < plItems; i++, cnt++)
+   pixmapPlaylist[pmText]->SetDrawPortPoint(cPoint(0, -(plTop - plPortFirst) * plItemHeight));
+
+   if (plCurrent >= plTop && plCurrent < plTop + plItems)
    {
-      tColor color = clrTextDark;
+      int ay = pixmapPlaylist[pmBack]->ViewPort().Y() + (plCurrent - plTop) * plItemHeight;
+
+      pixmapPlCurrent[pmBack]->SetViewPort(cRect(pixmapPlCurrent[pmBack]->ViewPort().X(), ay,
+                                                 pixmapPlCurrent[pmBack]->ViewPort().Width(),
+                                                 pixmapPlCurrent[pmBack]->ViewPort().Height()));
+   }
+
+   pixmapPlaylist[pmBack]->SetAlpha(alpha);
+   pixmapPlaylist[pmText]->SetAlpha(alpha);
+
+   if (!menu)
+      pixmapPlCurrent[pmBack]->SetAlpha(alpha);
+
+   cPixmap::Unlock();
+
+   return done;
+}
+
+//***************************************************************************
+// Draw Playlist Row
+//  - track i into its row of the draw port, skipped if the row already
+//    shows it with the same texts, cover and marks
+//***************************************************************************
+
+int cSqueezeOsd::drawPlaylistRow(const PlaylistSnapshot* s, int i)
+{
+   int r = i - plPortFirst;
+   const TrackInfo* track = i < s->getTrackCount() ? s->getTrack(i) : 0;
+   int flags = 0;
+   size_t hash = 0;
+
+   if (r < 0 || r >= (int)plRows.size())
+      return fail;
+
+   if (track)
+   {
+      hash = std::hash<std::string>()(std::string(track->title) + "\n" + track->artist
+                                      + "\n" + LmcCom::coverKey(track)) | 1;
 
       if (i == plCurrent)
-      {
-         int ay = pixmapPlaylist[pmBack]->ViewPort().Y() + y;
+         flags |= prfCursor;
 
-         color = clrCyan;
-         pixmapPlCurrent[pmBack]->SetViewPort(cRect(pixmapPlCurrent[pmBack]->ViewPort().X(), ay,
-                                                    pixmapPlCurrent[pmBack]->ViewPort().Width(),
-                                                    pixmapPlCurrent[pmBack]->ViewPort().Height()));
-      }
+      if (i == s->state.plIndex)
+         flags |= prfPlaying;
+   }
 
-      if (i == currentState->plIndex)
-      {
-         color = clrWhite;
-         drawSymbol(pixmapPlaylist[pmText], "speaker.png", imgX, imgY+y, imgWH, imgWH);
-      }
+   PlaylistRow& row = plRows[r];
 
-      drawTrackCover(pixmapPlaylist[pmText], lmc->getTrack(i), 0, y, coverHeight);
+   if (row.drawn && row.hash == hash && row.flags == flags
+       && (!row.coverRetryAt || cTimeMs::Now() < row.coverRetryAt))
+      return done;
 
-      int x = coverHeight + border;
-      pixmapPlaylist[pmText]->DrawText(cPoint(x, y),
-                                       cString::sprintf("%s", lmc->getTrack(i)->title),
-                                       color, clrTransparent, fontPl, pixmapPlaylist[pmText]->ViewPort().Width());
+   int y = r * plItemHeight;
+   int width = pixmapPlaylist[pmText]->DrawPort().Width();
+
+   row.drawn = yes;
+   row.hash = hash;
+   row.flags = flags;
+   row.coverRetryAt = 0;
+
+   if (!track)
+   {
+      pixmapPlaylist[pmText]->DrawRectangle(cRect(0, y, width, plItemHeight), clrTransparent);
+      return done;
+   }
 
-      y += fontPl->Height();
+   static EventCounter* rows = Statistics::getCounter("osd.playlistRows");
 
-      pixmapPlaylist[pmText]->DrawText(cPoint(x, y),
-                               cString::sprintf("%s", lmc->getTrack(i)->artist),
-                               color, clrTransparent, fontPl, pixmapPlaylist[pmText]->ViewPort().Width());
+   rows->add();
 
-      y += fontPl->Height()+plItemSpace;
+   // rendered before (other position, cursor moved back, former session)?
+
+   std::string key = *cString::sprintf("pl:%d:%zx:%d:%d", track->id, hash, flags, width);
+   const cImage* cached = cRowCache::get(key);
+
+   if (cached)
+   {
+      pixmapPlaylist[pmText]->DrawImage(cPoint(0, y), *cached);
+      return done;
    }
 
-   pixmapPlaylist[pmBack]->SetAlpha(alpha);
-   pixmapPlaylist[pmText]->SetAlpha(alpha);
+   // render it aside and copy it to the row
 
-   if (!menu)
-      pixmapPlCurrent[pmBack]->SetAlpha(alpha);
+   cPixmapMemory pixmap(0, cRect(0, 0, width, plItemHeight));
+   tColor color = flags & prfCursor ? clrCyan : clrTextDark;
+   int imgWH = pixmapPlCurrent[pmText]->ViewPort().Height() / 3.0 * 2.0;
+   int coverHeight = pixmapPlCurrent[pmText]->ViewPort().Height();
+   int imgX = pixmapPlCurrent[pmText]->ViewPort().Width() - imgWH;
+   int imgY = imgWH / 4;
+   int ty = 0;
 
-   cPixmap::Unlock();
+   pixmap.Fill(clrTransparent);
+
+   if (flags & prfPlaying)
+   {
+      color = clrWhite;
+      drawSymbol(&pixmap, "speaker.png", imgX, imgY, imgWH, imgWH);
+   }
+
+   int hasCover = drawTrackCover(&pixmap, track, 0, 0, coverHeight) == success;
+
+   int x = coverHeight + border;
+   pixmap.DrawText(cPoint(x, ty), cString::sprintf("%s", track->title),
+                   color, clrTransparent, fontPl, width);
+
+   ty += fontPl->Height();
+
+   pixmap.DrawText(cPoint(x, ty), cString::sprintf("%s", track->artist),
+                   color, clrTransparent, fontPl, width);
+
+   cImage image(cSize(width, plItemHeight), (const tColor*)pixmap.Data());
 
-   delete imgSpeaker;
+   pixmapPlaylist[pmText]->DrawImage(cPoint(0, y), image);
+
+   // without a cover (not downloadable yet) the row is drawn again when
+   // the cover is asked for the next time
+
+   if (hasCover)
+      cRowCache::put(key, image);
+   else
+      row.coverRetryAt = cTimeMs::Now() + coverRetryInterval;
 
    return done;
 }
 
+//***************************************************************************
+// Move Playlist Port
+//  - the draw port shows the tracks from 'first' on, rows still inside
+//    are scrolled (pixel copy) to their new place, the others drawn later
+//***************************************************************************
+
+void cSqueezeOsd::movePlaylistPort(int first)
+{
+   int rows = plRows.size();
+   int shift = first - plPortFirst;
+   int width = pixmapPlaylist[pmText]->DrawPort().Width();
+
+   if (!shift)
+      return;
+
+   if (abs(shift) >= rows)
+   {
+      plRows.assign(rows, PlaylistRow());
+   }
+   else if (shift > 0)
+   {
+      pixmapPlaylist[pmText]->Scroll(cPoint(0, 0), cRect(0, shift * plItemHeight, width, (rows - shift) * plItemHeight));
+      plRows.erase(plRows.begin(), plRows.begin() + shift);
+      plRows.insert(plRows.end(), shift, PlaylistRow());
+   }
+   else
+   {
+      pixmapPlaylist[pmText]->Scroll(cPoint(0, -shift * plItemHeight), cRect(0, 0, width, (rows + shift) * plItemHeight));
+      plRows.erase(plRows.end() + shift, plRows.end());
+      plRows.insert(plRows.begin(), -shift, PlaylistRow());
+   }
+
+   plPortFirst = first;
+}
+
 //***************************************************************************
 // Draw Info Box
 //***************************************************************************
 
 int cSqueezeOsd::drawStatus()
 {
+   static LatencyStat* stat = Statistics::get("osd.status");
+   LatencyProbe probe(stat);
    char* name = 0;
 
    if (!osd)
@@ -1008,6 +1294,8 @@ int cSqueezeOsd::drawVolume(cPixmap* pixmap, int x, int y, int width)
 
 int cSqueezeOsd::drawButtons()
 {
+   static LatencyStat* stat = Statistics::get("osd.buttons");
+   LatencyProbe probe(stat);
    if (!osd)
       return fail;
 
@@ -1054,7 +1342,7 @@ int cSqueezeOsd::drawButtons()
 // Draw Cover
 //***************************************************************************
 
-int cSqueezeOsd::drawTrackCover(cPixmap* pixmap, TrackInfo* track,
+int cSqueezeOsd::drawTrackCover(cPixmap* pixmap, const TrackInfo* track,
                                 int x, int y, int size)
 {
    cImage* image = 0;
@@ -1066,32 +1354,40 @@ int cSqueezeOsd::drawTrackCover(cPixmap* pixmap, TrackInfo* track,
 
    cPixmap::Lock();
 
-   if (!isEmpty(track->artworkurl))
-      hash = track->artworkurl;
-   else if (!isEmpty(track->artworkTrackId))
-      hash = track->artworkTrackId;
-   else
-      hash = num2Str(track->id).c_str();
+   hash = LmcCom::coverKey(track);
 
    // clear cache on metadata change
 
    if (lmc->hasMetadataChanged())
+   {
       imgLoader->clearCache();
+      coverRetries.clear();
+   }
 
-   // check cache
+   // check cache, a cover failed to load is not requested again
+   // before the retry interval
 
    image = imgLoader->fromCache(hash);
 
-   if (!image)
+   auto retry = coverRetries.find(hash);
+
+   if (!image && (retry == coverRetries.end() || cTimeMs::Now() >= retry->second))
    {
       if (lmc->getCover(&cover, track) == success)
       {
          if (imgLoader->loadImage(cover.memory, cover.size) == success)
          {
-            image = imgLoader->createImage(size, size, yes);
-            imgLoader->addCache(hash, image);
+            cImage* scaled = imgLoader->createImage(size, size, yes);
+
+            image = imgLoader->addCache(hash, scaled);
+            delete scaled;
          }
       }
+
+      if (image)
+         coverRetries.erase(hash);
+      else
+         coverRetries[hash] = cTimeMs::Now() + coverRetryInterval;
    }
 
    if (image)
@@ -1099,7 +1395,7 @@ int cSqueezeOsd::drawTrackCover(cPixmap* pixmap, TrackInfo* track,
 
    cPixmap::Unlock();
 
-   return done;
+   return image ? success : done;
 }
 
 //***************************************************************************
@@ -1108,8 +1404,10 @@ int cSqueezeOsd::drawTrackCover(cPixmap* pixmap, TrackInfo* track,
 
 int cSqueezeOsd::drawCover()
 {
+   static LatencyStat* stat = Statistics::get("osd.cover");
+   LatencyProbe probe(stat);
    MemoryStruct cover;
-   TrackInfo* currentTrack = lmc->getCurrentTrack();
+   const TrackInfo* currentTrack = snapshot->getCurrentTrack();
    std::string hash;
    cImage* image = 0;
 
@@ -1125,12 +1423,7 @@ int cSqueezeOsd::drawCover()
       imgHW = pixmapCover[pmText]->ViewPort().Height() / 2;
    }
 
-   if (!isEmpty(currentTrack->artworkurl))
-      hash = std::string("cover_") + currentTrack->artworkurl;
-   else if (!isEmpty(currentTrack->artworkTrackId))
-      hash = std::string("cover_") + currentTrack->artworkTrackId;
-   else
-      hash = std::string("cover_") + num2Str(currentTrack->id).c_str();
+   hash = "cover_" + LmcCom::coverKey(currentTrack);
 
    cPixmap::Lock();
 
@@ -1158,8 +1451,10 @@ int cSqueezeOsd::drawCover()
             // optional store the cover on FS
             // storeFile(&cover, "/tmp/squeeze_cover.jpg");
 
-            image = imgLoader->createImage(imgHW, imgHW, yes);
-            imgLoader->addCache(hash, image);
+            cImage* scaled = imgLoader->createImage(imgHW, imgHW, yes);
+
+            image = imgLoader->addCache(hash, scaled);
+            delete scaled;
          }
       }
    }
@@ -1236,6 +1531,8 @@ int cSqueezeOsd::drawCover()
 
 int cSqueezeOsd::scrollLyrics()
 {
+   static LatencyStat* stat = Statistics::get("osd.lyrics");
+   LatencyProbe probe(stat);
    if (!osd)
       return fail;
 
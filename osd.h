@@ -8,6 +8,9 @@
 #ifndef __SQUEZZEOSD_H
 #define __SQUEZZEOSD_H
 
+#include <map>
+#include <vector>
+
 #include <vdr/thread.h>
 #include <vdr/plugin.h>
 
@@ -21,7 +24,7 @@ class cMyStatus;
 // Osd
 //***************************************************************************
 
-class cSqueezeOsd : public cThread
+class cSqueezeOsd : public cThread, public LmcCom::TrackListener
 {
    public:
 
@@ -32,6 +35,12 @@ class cSqueezeOsd : public cThread
          pmCount
       };
 
+      enum PlaylistRowFlags
+      {
+         prfPlaying = 0x01,
+         prfCursor  = 0x02
+      };
+
       cSqueezeOsd(const char* aResDir = "");
       virtual ~cSqueezeOsd();
 
@@ -41,12 +50,14 @@ class cSqueezeOsd : public cThread
       void view();
       void hide();
       void Action();
+      void tracksArrived(const PlaylistSnapshot* building);
+      void refreshSnapshot();
       void stop();
 
       void setForce()                { forceNextDraw = yes; }
       void setButtonLevel(int level) { buttonLevel = level; forceNextDraw = yes; }
 
-      int playlistCount()            { return currentState->plCount; }
+      int playlistCount()            { return lmc->getSnapshot()->state.plCount; }
       int ProcessKey(int key);
 
       int activateMenu(LmcCom* aLmc)
@@ -67,25 +78,28 @@ class cSqueezeOsd : public cThread
 
       // osd2web
 
-      int sendInfoBox(TrackInfo* currentTrack);
+      int sendInfoBox(const TrackInfo* currentTrack);
 
       // draw
 
       int drawOsd();
       int drawCover();
-      int drawTrackCover(cPixmap* pixmap, TrackInfo* track, int x, int y, int size);
+      int drawTrackCover(cPixmap* pixmap, const TrackInfo* track, int x, int y, int size);
 
       int drawInfoBox();
       int drawProgress(int y = na);
-      int drawPlaylist();
+      int drawPlaylist(const PlaylistSnapshot* s = 0);
+      int drawPlaylistRow(const PlaylistSnapshot* s, int i);
+      void movePlaylistPort(int first);
       int drawStatus();
       int drawButtons();
       int drawVolume(cPixmap* pixmap, int x, int y, int width);
       int drawMenu();
+      int drawMenuRow(const char* text, int x, int y);
       int scrollLyrics();
 
       int createBox(cPixmap* pixmap[], int x, int y, int width, int height,
-                    tColor color, tColor blend, int radius);
+                    tColor color, tColor blend, int radius, int drawPortHeight = 0);
 
       int drawSymbol(cPixmap* pixmap, const char* name, int& x, int y, int width = na, int height = na);
 
@@ -112,7 +126,7 @@ class cSqueezeOsd : public cThread
       {
          if (menu)
             return menu->getActive()->Blue();
-         return buttonLevel == 0 ? (currentState->plCount ? tr("Clear") : tr("Random")) : tr("Vol+");
+         return buttonLevel == 0 ? (playlistCount() ? tr("Clear") : tr("Random")) : tr("Vol+");
       }
 
       // data
@@ -127,12 +141,34 @@ class cSqueezeOsd : public cThread
       int forceMenuDraw;
       int forcePlaylistDraw;
       int loopActive;
+      tThreadId actionThread;     // of Action(), the only one drawing
       int plCurrent;
       int plUserAction;
       int plTop;
       time_t lastScrollAt;
 
       int plItems;
+      int plFirstPageDrawn;
+
+      // the playlist text pixmap has a draw port of plPortPages pages, the
+      //  rows keep what they show and are only drawn again if that changed,
+      //  scrolling moves the draw port point
+
+      struct PlaylistRow
+      {
+         int drawn;
+         size_t hash;               // title, artist and cover, 0 for an empty row
+         int flags;                 // PlaylistRowFlags
+         uint64_t coverRetryAt;     // [ms] drawn without the cover, again at
+      };
+
+      enum { plPortPages = 3 };
+      enum { coverRetryInterval = 30000 };     // [ms] to ask for a missing cover again
+
+      std::map<std::string,uint64_t> coverRetries;  // covers failed to load by key, next try at
+
+      std::vector<PlaylistRow> plRows;  // first row shows track plPortFirst
+      int plPortFirst;
       int plItemSpace;
       int plItemHeight;
       int menuItemHeight;
@@ -143,7 +179,8 @@ class cSqueezeOsd : public cThread
       int border;                 // border width in pixel
 
       cImageMagickWrapper* imgLoader;
-      PlayerState* currentState;
+      SnapshotPtr snapshot;             // drawn state, only touched by our thread
+      const PlayerState* currentState;  // -> snapshot->state
       cPlugin* osd2web;
 
       cPixmap* pixmapCover[pmCount];
@@ -8,7 +8,7 @@
 #include "osd.h"
 #include "service.h"
 
-int cSqueezeOsd::sendInfoBox(TrackInfo* currentTrack)
+int cSqueezeOsd::sendInfoBox(const TrackInfo* currentTrack)
 {
    if (!osd2web)
       return done;
@@ -8,8 +8,12 @@
 #include "squeezebox.h"
 #include "config.h"
 #include "osd.h"
+#include "lmcmanager.h"
+#include "statecache.h"
+#include "libindex.h"
 
 #include "lib/common.h"
+#include "lib/stats.h"
 
 cSqueezeConfig cfg;
 
@@ -39,6 +43,7 @@ class cSqueezeControl : public cControl
       cPluginSqueezebox* plugin;
       int buttonLevel;
       int initialized;
+      time_t initFailedAt;
 };
 
 //***************************************************************************
@@ -46,15 +51,16 @@ class cSqueezeControl : public cControl
 //***************************************************************************
 
 cSqueezeControl::cSqueezeControl(cPluginSqueezebox* aPlugin, const char* aResDir)
-   : cControl(player = new cSqueezePlayer)
+   : cControl(player = new cSqueezePlayer(aPlugin->getStandby()))
 {
    plugin = aPlugin;
 
    buttonLevel = 0;
    resDir = strdup(aResDir);
-   lmc = 0;
+   lmc = LmcManager::acquire();      // already now, the player checks the registration with it
    osdThread = 0;
    initialized = no;
+   initFailedAt = 0;
 }
 
 cSqueezeControl::~cSqueezeControl()
@@ -64,8 +70,9 @@ cSqueezeControl::~cSqueezeControl()
    free(resDir);
 
    delete player;
-   delete lmc;
    delete osdThread;
+
+   LmcManager::release();
 }
 
 //***************************************************************************
@@ -74,22 +81,8 @@ cSqueezeControl::~cSqueezeControl()
 
 int cSqueezeControl::init()
 {
-   delete lmc;
-   lmc = new LmcCom(cfg.mac);
-
-   tell(eloAlways, "Trying connetion to '%s:%d', my mac is '%s'",
-        cfg.lmcHost, cfg.lmcPort, cfg.mac);
-
-   if (lmc->open(cfg.lmcHost, cfg.lmcPort) != success)
-   {
-      tell(eloAlways, "Error: Opening connection to LMC server at '%s:%d' failed",
-           cfg.lmcHost, cfg.lmcPort);
-
+   if (!lmc->isOpen() && lmc->open(cfg.lmcHost, cfg.lmcPort) != success)
       return fail;
-   }
-
-   tell(eloAlways, "Connection to LMC server at '%s:%d' established",
-        cfg.lmcHost, cfg.lmcPort);
 
    osdThread = new cSqueezeOsd(resDir);
 
@@ -113,7 +106,6 @@ int cSqueezeControl::init()
 
 eOSState cSqueezeControl::ProcessKey(eKeys key)
 {
-   static int lastRetryAt = 0;
    eOSState state = osContinue;
 
    if (key == kBack)
@@ -129,21 +121,19 @@ eOSState cSqueezeControl::ProcessKey(eKeys key)
 
    if (!initialized)
    {
-      if (lastRetryAt+4 > time(0))
-         return state;
-
-      lastRetryAt = time(0);
+      // the player thread raises 'ready' as soon as the LMS knows squeezelite,
+      // only a failed init is retried delayed
 
-      if (!player->isRunning())
-      {
-         tell(eloAlways, "Still waiting on player");
+      if (!player->isReady() || initFailedAt+2 > time(0))
          return state;
-      }
 
-      tell(eloDebug, "Player running, try initialized TCP connection and OSD now");
+      tell(eloDebug, "Player ready, try initialized TCP connection and OSD now");
 
       if (init() != success)
+      {
+         initFailedAt = time(0);
          return state;
+      }
    }
 
    if (key != kNone)
@@ -273,15 +263,53 @@ bool cPluginSqueezebox::Initialize()
 
 bool cPluginSqueezebox::Start()
 {
+   startLogThread();
+   loglevel = cfg.logLevel;
+
+   if (cfg.persistentPlayer)
+   {
+      standby = new cSqueezelite(yes);
+      standby->start();
+   }
+
+   // last state first, the watcher reconciles it with the LMS
+
+   cStateCache::setDirectory(CacheDirectory(PLUGIN_NAME_I18N));
+   cStateCache::load();
+
+   LmcManager::startWatcher();
+
+   RadioCache::setTtl(cfg.radioCacheTtl * 60);
+   LmcManager::startRefresher();
+
+   if (cfg.libraryIndex)
+   {
+      cLibraryIndex::setDirectory(CacheDirectory(PLUGIN_NAME_I18N));
+      cLibraryIndex::load();
+      cLibraryIndex::startIndexer();
+   }
+
    return true;
 }
 
 void cPluginSqueezebox::Stop()
 {
+   cStateCache::save(yes);
+   cMenuWorker::reap(yes);           // the loaders of closed menus
+   cLibraryIndex::stopIndexer();
+   LmcManager::stopRefresher();
+   LmcManager::stopWatcher();
+
+   delete standby;
+   standby = 0;
+
+   stopLogThread();
 }
 
 void cPluginSqueezebox::Housekeeping()
 {
+   cStateCache::save();
+   cMenuWorker::reap();
 }
 
 void cPluginSqueezebox::MainThreadHook()
@@ -318,6 +346,12 @@ bool cPluginSqueezebox::SetupParse(const char* Name, const char* Value)
    if      (!strcasecmp(Name, "logLevel"))     cfg.logLevel = atoi(Value);
    else if (!strcasecmp(Name, "lmcPort"))      cfg.lmcPort = atoi(Value);
    else if (!strcasecmp(Name, "lmcHttpPort"))  cfg.lmcHttpPort = atoi(Value);
+   else if (!strcasecmp(Name, "jsonRpc"))      cfg.jsonRpc = atoi(Value);
+   else if (!strcasecmp(Name, "tcpNoDelay"))   cfg.tcpNoDelay = atoi(Value);
+   else if (!strcasecmp(Name, "persistentPlayer")) cfg.persistentPlayer = atoi(Value);
+   else if (!strcasecmp(Name, "libraryIndex")) cfg.libraryIndex = atoi(Value);
+   else if (!strcasecmp(Name, "sortMenus"))    cfg.sortMenus = atoi(Value);
+   else if (!strcasecmp(Name, "radioCacheTtl")) cfg.radioCacheTtl = atoi(Value);
    else if (!strcasecmp(Name, "shadeTime"))    cfg.shadeTime = atoi(Value);
    else if (!strcasecmp(Name, "shadeLevel"))   cfg.shadeLevel = atoi(Value);
    else if (!strcasecmp(Name, "rounded"))      cfg.rounded = atoi(Value);
@@ -342,11 +376,63 @@ bool cPluginSqueezebox::Service(const char* Id, void* Data)
 
 const char** cPluginSqueezebox::SVDRPHelpPages()
 {
-   return 0;
+   static const char* HelpPages[] =
+   {
+      "STAT\n"
+      "    Show latency statistics of LMS requests, cover download,\n"
+      "    image processing and OSD drawing (count, avg, p50, p90, p99, max)\n"
+      "    and the squeezelite counters (restarts, underruns, decoder errors, ..)",
+      "RSET\n"
+      "    Reset the latency statistics and counters",
+      "INFO\n"
+      "    Show the state of the player (only while the squeezebox is active)",
+      0
+   };
+
+   return HelpPages;
 }
 
 cString cPluginSqueezebox::SVDRPCommand(const char* Command, const char* Option, int &ReplyCode)
 {
+   if (strcasecmp(Command, "STAT") == 0)
+   {
+      ReplyCode = 250;
+      return cString(Statistics::dump().c_str());
+   }
+
+   if (strcasecmp(Command, "RSET") == 0)
+   {
+      Statistics::reset();
+      ReplyCode = 250;
+      return "Statistics reset";
+   }
+
+   if (strcasecmp(Command, "INFO") == 0)
+   {
+      // SVDRP has its own thread (since VDR 2.3), the connection may be
+      // released by the control meanwhile, hold it while reading the
+      // snapshot, the snapshot itself stays valid
+
+      LmcCom* lmc = LmcManager::acquire();
+      SnapshotPtr s = lmc->getSnapshot();
+      int connected = lmc->isOpen();
+
+      LmcManager::release();
+
+      if (!connected)
+      {
+         ReplyCode = 550;
+         return "Squeezebox not connected to the LMS";
+      }
+
+      const TrackInfo* t = s->getCurrentTrack();
+
+      ReplyCode = 250;
+      return cString::sprintf("%s, volume %d, track %d of %d: %s - %s",
+                              s->state.mode, s->state.volume, s->state.plIndex+1,
+                              s->state.plCount, t->artist, t->title);
+   }
+
    return 0;
 }
 
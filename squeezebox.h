@@ -16,6 +16,7 @@
 
 #include "HISTORY.h"
 #include "lmccom.h"
+#include "squeezelite.h"
 
 static const char *DESCRIPTION    = "Squeezebox - a client for the Logitech Media Server";
 static const char *MAINMENUENTRY  = "Squeezebox";
@@ -34,23 +35,23 @@ class cSqueezePlayer : public cPlayer, cThread
 //          pmExternAudioOnlyBlack_THIS_SHOULD_BE_AVOIDED
 //       };
 
-      cSqueezePlayer();
+      cSqueezePlayer(cSqueezelite* aStandby = 0);
       virtual ~cSqueezePlayer();
 
       virtual void Stop();
 
-      int isRunning() { return running; }
+      int isRunning() { return squeezelite->isRunning(); }
+      int isReady()   { return ready; }       // squeezelite is known by the LMS
 
    protected:
 
       virtual void Activate(bool on);
       virtual void Action();
-      virtual int startPlayer();
-      virtual int stopPlayer();
 
       cPlugin* seduatmo = 0;
-      int running;
-      pid_t pid;
+      cSqueezelite* squeezelite;
+      int ownProcess;
+      int ready;
 };
 
 //***************************************************************************
@@ -83,6 +84,12 @@ class cPluginSqueezebox : public cPlugin
       virtual bool Service(const char *Id, void *Data = NULL);
       virtual const char **SVDRPHelpPages(void);
       virtual cString SVDRPCommand(const char *Command, const char *Option, int &ReplyCode);
+
+      cSqueezelite* getStandby() { return standby; }
+
+   private:
+
+      cSqueezelite* standby = 0;     // persistent squeezelite, 0 if disabled
 };
 
 //***************************************************************************
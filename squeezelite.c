@@ -0,0 +1,587 @@
+/*
+ * squeezelite.c
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <fcntl.h>
+
+#include <glob.h>
+#include <ctype.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include <string>
+
+#include "lib/common.h"
+#include "lib/stats.h"
+
+#include "config.h"
+#include "lmcmanager.h"
+#include "squeezelite.h"
+
+//***************************************************************************
+// Squeezelite
+//***************************************************************************
+
+cSqueezelite::cSqueezelite(int aPersistent)
+{
+   persistent = aPersistent;
+   running = no;
+   ready = no;
+   power = !persistent;
+   pid = 0;
+   outFd = na;
+   inFd = na;
+   startAt = 0;
+   lineFill = 0;
+}
+
+cSqueezelite::~cSqueezelite()
+{
+   stop();
+}
+
+//***************************************************************************
+// Start / Stop
+//***************************************************************************
+
+int cSqueezelite::start()
+{
+   if (Active())
+      return done;
+
+   return Start() ? success : fail;
+}
+
+int cSqueezelite::stop()
+{
+   Cancel(-1);            // only tell the thread, the supervisor reaps the process
+   wakeup.Signal();
+   stopProcess();
+
+   // no hard cancel, the ready check queries the shared connection,
+   // the thread ends after the process at the latest by killTimeout
+
+   while (Active())
+      cCondWait::SleepMs(10);
+
+   return success;
+}
+
+//***************************************************************************
+// Action
+//  - restart squeezelite as long as we are running, the delay doubles
+//    with each crash in a row up to 'backoffMax'
+//***************************************************************************
+
+void cSqueezelite::Action()
+{
+   int crashes = 0;
+
+   while (Running())
+   {
+      time_t startedAt = time(0);
+
+      if (startProcess() == success)
+         supervise();
+
+      if (!Running())
+         break;
+
+      if (time(0) - startedAt >= stableRun)
+         crashes = 0;
+
+      int delay = crashes < 6 ? backoffMin << crashes : backoffMax;
+
+      if (delay > backoffMax)
+         delay = backoffMax;
+
+      crashes++;
+      Statistics::increment("squeezelite.restarts");
+      tell(eloAlways, "Restarting %s in %d seconds", cfg.squeezeCmd, delay / 1000);
+
+      wakeup.Wait(delay);
+   }
+}
+
+//***************************************************************************
+// Set Power
+//  - in persistent mode the player is switched off while no control is
+//    open, squeezelite stops and releases the audio device
+//***************************************************************************
+
+int cSqueezelite::setPower(int on)
+{
+   power = on;
+
+   if (!ready)
+      return done;        // applied as soon as the LMS knows the player
+
+   return sendPower();
+}
+
+int cSqueezelite::sendPower()
+{
+   int status;
+   LmcCom* lmc = LmcManager::acquire();
+
+   if (!lmc->isOpen())
+      lmc->open(cfg.lmcHost, cfg.lmcPort);
+
+   tell(eloDetail, "Switching player '%s' %s", cfg.mac, power ? "on" : "off");
+
+   status = lmc->execute("power", power ? "1" : "0");
+
+   LmcManager::release();
+
+   return status;
+}
+
+//***************************************************************************
+// Start Process
+//***************************************************************************
+
+int cSqueezelite::startProcess()
+{
+   int fd[2];
+   int wrfd[2];
+   int res = 0;
+
+   startAt = Statistics::usNow();
+   readyCheck.Set(0);
+
+   // softhddevice (or pulseaudio) has to release the audio device first,
+   // without a control the device stays with the output device anyway
+
+   if (power)
+      waitOutputReleased(5000);
+
+   res += pipe(fd);
+   res += pipe(wrfd);
+
+   if (res != 0)
+   {
+      tell(eloAlways, "Creating pipe failed, %s\n", strerror(errno));
+      return fail;
+   }
+
+   if ((pid = fork()) < 0)
+   {
+      tell(eloAlways, "fork failed with %s\n", strerror(errno));
+      pid = 0;
+      close(fd[0]); close(fd[1]);
+      close(wrfd[0]); close(wrfd[1]);
+      return fail;
+   }
+
+   if (pid == 0)     // child code
+   {
+      char* argv[30]; memset(argv, 0, sizeof(argv));
+      int argc = 0;
+
+      logAfterFork();               // our tell() writes directly, no log thread here
+
+      dup2(fd[1], STDERR_FILENO);   // Redirect stderr into writing end of pipe
+      dup2(fd[1], STDOUT_FILENO);   // Redirect stdout into writing end of pipe
+      dup2(wrfd[0], STDIN_FILENO);  // Redirect reading end of pipe into stdin
+
+      // Now that we have copies where needed, we can close all the child's other references
+      // to the pipes.
+
+      close(fd[0]);
+      close(fd[1]);
+      close(wrfd[0]);
+      close(wrfd[1]);
+
+      // create argument array
+
+      argv[argc++] = strdup(cfg.squeezeCmd);
+      argv[argc++] = strdup("-s");
+      argv[argc++] = strdup(cfg.lmcHost);
+      argv[argc++] = strdup("-m");
+      argv[argc++] = strdup(cfg.mac);
+      argv[argc++] = strdup("-n");
+      argv[argc++] = strdup(cfg.playerName);
+
+      if (!isEmpty(cfg.audioDevice))
+      {
+         argv[argc++] = strdup("-o");
+         argv[argc++] = strdup(cfg.audioDevice);
+      }
+
+      if (!isEmpty(cfg.alsaOptions))
+      {
+         argv[argc++] = strdup("-a");
+         argv[argc++] = strdup(cfg.alsaOptions);
+      }
+
+      if (persistent)
+      {
+         argv[argc++] = strdup("-C");        // close output device when idle [s]
+         argv[argc++] = strdup("1");
+      }
+
+      argv[argc] = 0;
+
+      // start player ..
+
+      std::string tmp;
+
+      for (int i = 0; i < argc; i++)
+      {
+         if (tmp.length())
+            tmp += " ";
+         tmp += std::string(argv[i]);
+      }
+
+      tell(eloAlways, "Starting player with '%s", tmp.c_str());
+
+      execv(cfg.squeezeCmd, argv);
+
+      tell(eloAlways, "Process squeezelite ended unexpectedly, reason was '%s'\n", strerror(errno));
+
+      _exit(-1);        // never return into the threads of VDR
+   }
+
+   // parent code
+
+   close(fd[1]);     // Don't need writing end of the stderr pipe in parent.
+   close(wrfd[0]);   // Don't need the reading end of the stdin pipe in the parent
+
+   outFd = fd[0];
+   inFd = wrfd[1];
+   lineFill = 0;
+   fcntl(outFd, F_SETFL, fcntl(outFd, F_GETFL) | O_NONBLOCK);
+
+   tell(eloAlways, "started %s with pid %d\n", cfg.squeezeCmd, pid);
+   running = yes;
+
+   return success;
+}
+
+//***************************************************************************
+// Supervise
+//  - one poll loop for the output pipe and the pidfd of the child, until
+//    ready it also checks the registration at the LMS
+//  - without pidfd (kernel < 5.3) the exit is checked on each wakeup
+//***************************************************************************
+
+int cSqueezelite::supervise()
+{
+   int status = 0;
+   int exited = no;
+   int pidFd = na;
+   uint64_t stopAt = 0;
+   int killed = no;
+   LmcCom* lmc = LmcManager::acquire();      // released when ready
+
+#ifdef SYS_pidfd_open
+   pidFd = syscall(SYS_pidfd_open, pid, 0);
+#endif
+
+   if (pidFd < 0)
+      tell(eloDetail, "No pidfd available (%s), polling the exit of %d", strerror(errno), pid);
+
+   while (!exited)
+   {
+      struct pollfd fds[2];
+      int count = 0;
+      int pidIdx = na;
+
+      if (outFd >= 0)
+      {
+         fds[count].fd = outFd;
+         fds[count].events = POLLIN;
+         count++;
+      }
+
+      if (pidFd >= 0)
+      {
+         pidIdx = count;
+         fds[count].fd = pidFd;
+         fds[count].events = POLLIN;
+         count++;
+      }
+
+      for (int i = 0; i < count; i++)
+         fds[i].revents = 0;
+
+      if (poll(fds, count, ready ? 500 : 50) < 0 && errno != EINTR)
+         tell(eloAlways, "Error: poll failed, %s", strerror(errno));
+
+      if (outFd >= 0 && fds[0].revents)
+         readOutput();
+
+      if (pidIdx == na || fds[pidIdx].revents)
+         exited = waitpid(pid, &status, WNOHANG) != 0;
+
+      if (exited)
+      {
+         readOutput();                    // the rest of its last words
+         break;
+      }
+
+      if (!ready && lmc)
+         checkReady(lmc);
+
+      // stop requested, SIGINT is send by stopProcess(), insist after a while
+
+      if (!Running())
+      {
+         if (!stopAt)
+            stopAt = Statistics::usNow();
+
+         else if (!killed && Statistics::usNow() - stopAt > killTimeout * 1000ULL)
+         {
+            tell(eloAlways, "%s ignores SIGINT, killing it", cfg.squeezeCmd);
+            kill(pid, SIGKILL);
+            killed = yes;
+         }
+      }
+   }
+
+   if (lmc)
+      LmcManager::release();
+
+   if (pidFd >= 0)
+      close(pidFd);
+
+   if (outFd >= 0)
+      close(outFd);          // Close the reading end of the stderr pipe
+
+   close(inFd);              // Close the writing end of the stdout pipe
+
+   outFd = na;
+   inFd = na;
+   pid = 0;
+   running = no;
+   ready = no;
+
+   if (WIFSIGNALED(status))
+      tell(eloAlways, "%s terminated by signal %d\n", cfg.squeezeCmd, WTERMSIG(status));
+   else
+      tell(eloAlways, "%s exited with %d\n", cfg.squeezeCmd, WEXITSTATUS(status));
+
+   return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? success : fail;
+}
+
+//***************************************************************************
+// Check Ready
+//  - squeezelite is ready as soon as the LMS knows it, the control
+//    initializes the OSD on the ready flag
+//  - called on every wakeup of the supervision (poll timeout and each
+//    line of the output), the LMS is asked every 'readyInterval' only
+//***************************************************************************
+
+int cSqueezelite::checkReady(LmcCom*& lmc)
+{
+   if (!lmc->isOpen() && reopen.TimedOut())
+   {
+      lmc->open(cfg.lmcHost, cfg.lmcPort);
+      reopen.Set(reopenInterval);
+   }
+
+   int connected = no;
+
+   if (readyCheck.TimedOut())
+   {
+      connected = lmc->isOpen() && lmc->isPlayerConnected();
+      readyCheck.Set(readyInterval);
+   }
+
+   if (connected)
+   {
+      static LatencyStat* stat = Statistics::get("player.startup");
+
+      stat->add(Statistics::usNow() - startAt);
+      tell(eloAlways, "Player '%s' connected to LMS after %llu ms", cfg.mac,
+           (unsigned long long)(Statistics::usNow() - startAt) / 1000);
+
+      ready = yes;
+
+      if (persistent)
+         sendPower();
+   }
+   else if (Statistics::usNow() - startAt > readyTimeout * 1000ULL)
+   {
+      tell(eloAlways, "Player '%s' not seen by the LMS after %d ms", cfg.mac, readyTimeout);
+      ready = yes;
+   }
+
+   if (ready)
+   {
+      LmcManager::release();
+      lmc = 0;
+   }
+
+   return ready ? success : fail;
+}
+
+//***************************************************************************
+// Read Output
+//  - read what is there without blocking, complete lines are processed
+//***************************************************************************
+
+int cSqueezelite::readOutput()
+{
+   int res;
+
+   if (outFd < 0)
+      return done;
+
+   while ((res = read(outFd, line + lineFill, sizeLine - lineFill)) > 0)
+   {
+      char* start = line;
+      char* end;
+
+      lineFill += res;
+      line[lineFill] = 0;
+
+      while ((end = strchr(start, '\n')))
+      {
+         *end = 0;
+         processLine(start);
+         start = end + 1;
+      }
+
+      lineFill -= start - line;
+      memmove(line, start, lineFill);
+
+      if (lineFill == sizeLine)       // overlong line, take it as it is
+      {
+         line[lineFill] = 0;
+         processLine(line);
+         lineFill = 0;
+      }
+   }
+
+   if (res == 0)                      // EOF, squeezelite closed its output
+   {
+      if (lineFill)
+      {
+         line[lineFill] = 0;
+         processLine(line);
+         lineFill = 0;
+      }
+
+      close(outFd);
+      outFd = na;
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Process Line
+//  - log it and count what matters for the monitoring (SVDRP STAT)
+//***************************************************************************
+
+void cSqueezelite::processLine(char* line)
+{
+   Statistics::increment("squeezelite.lines");
+
+   if (strcasestr(line, "underrun"))
+      Statistics::increment("squeezelite.underruns");
+   else if (strcasestr(line, "decode") && (strcasestr(line, "error") || strcasestr(line, "fail")))
+      Statistics::increment("squeezelite.decodeErrors");
+   else if (strstr(line, "opening device") || strcasestr(line, "sample rate"))
+      Statistics::increment("squeezelite.reconfigs");
+   else if (strcasestr(line, "error") || strcasestr(line, "fail"))
+      Statistics::increment("squeezelite.errors");
+
+   tell(eloAlways, "[squeezelite] %s", line);
+}
+
+//***************************************************************************
+// Stop Process
+//  - the supervisor reaps it and sends SIGKILL if it doesn't stop
+//***************************************************************************
+
+int cSqueezelite::stopProcess()
+{
+   ready = no;
+
+   if (pid > 0)
+   {
+      tell(eloAlways, "stopping player");
+
+      if (kill(pid, SIGINT) != 0)
+      {
+         tell(eloAlways, "Stopping process '%s' failed, error was '%s'", cfg.squeezeCmd, strerror(errno));
+         return fail;
+      }
+   }
+
+   return success;
+}
+
+//***************************************************************************
+// Wait Output Released
+//  - poll the ALSA playback substreams until all of them are closed,
+//    restricted to the card of 'cfg.audioDevice' if it names one (hw:N)
+//***************************************************************************
+
+int cSqueezelite::outputBusy()
+{
+   char pattern[100];
+   const char* p;
+   int busy = no;
+   glob_t files;
+
+   if ((p = strstr(cfg.audioDevice, "hw:")) && isdigit(p[3]))
+      sprintf(pattern, "/proc/asound/card%d/pcm*p/sub*/status", atoi(p+3));
+   else
+      strcpy(pattern, "/proc/asound/card*/pcm*p/sub*/status");
+
+   if (glob(pattern, 0, 0, &files) != 0)
+      return no;                           // no ALSA at all, nothing to wait for
+
+   for (size_t i = 0; !busy && i < files.gl_pathc; i++)
+   {
+      char line[100] = "";
+      FILE* fp = fopen(files.gl_pathv[i], "r");
+
+      if (!fp)
+         continue;
+
+      if (fgets(line, sizeof(line), fp) && strncmp(line, "closed", 6) != 0)
+      {
+         tell(eloDebug, "Audio device '%s' still in use", files.gl_pathv[i]);
+         busy = yes;
+      }
+
+      fclose(fp);
+   }
+
+   globfree(&files);
+
+   return busy;
+}
+
+int cSqueezelite::waitOutputReleased(int timeout)
+{
+   cTimeMs timer(timeout);
+
+   while (outputBusy())
+   {
+      if (timer.TimedOut())
+      {
+         tell(eloAlways, "Audio device still busy after %d ms, continue anyway", timeout);
+         return fail;
+      }
+
+      usleep(20000);
+   }
+
+   tell(eloDetail, "Audio device free after %lld ms", (long long)timer.Elapsed());
+
+   return success;
+}
+
@@ -0,0 +1,86 @@
+/*
+ * squeezelite.h
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __SQUEEZELITE_H
+#define __SQUEEZELITE_H
+
+#include <sys/types.h>
+
+#include <vdr/thread.h>
+
+#include "lib/common.h"
+#include "lmccom.h"
+
+//***************************************************************************
+// Squeezelite
+//  - owns and supervises the squeezelite process: exit detection by pidfd,
+//    non blocking read of its output, restart with backoff after a crash
+//  - persistent: started once by the plugin and kept running across the
+//    control sessions, the audio device is only taken while the player is
+//    powered on (squeezelite -C closes it when idle)
+//***************************************************************************
+
+class cSqueezelite : public cThread
+{
+   public:
+
+      enum Misc
+      {
+         sizeLine       = 1024,
+         readyTimeout   = 10000,    // [ms]
+         readyInterval  = 300,      // [ms] between two questions to the LMS
+         reopenInterval = 1000,     // [ms]
+         killTimeout    = 2000,     // [ms] SIGINT -> SIGKILL
+         backoffMin     = 1000,     // [ms]
+         backoffMax     = 60000,    // [ms]
+         stableRun      = 60        // [s] resets the backoff
+      };
+
+      cSqueezelite(int aPersistent = no);
+      virtual ~cSqueezelite();
+
+      int start();
+      int stop();
+      int setPower(int on);
+
+      int isRunning()    { return running; }
+      int isReady()      { return ready; }            // known by the LMS
+      int isPersistent() { return persistent; }
+
+      static int waitOutputReleased(int timeout);
+
+   protected:
+
+      virtual void Action();
+
+      int startProcess();
+      int supervise();
+      int stopProcess();
+      int checkReady(LmcCom*& lmc);
+      int readOutput();
+      void processLine(char* line);
+      int sendPower();
+
+      static int outputBusy();
+
+      int persistent;
+      int running;
+      int ready;
+      int power;
+      pid_t pid;
+      int outFd;                    // stdout/stderr of squeezelite
+      int inFd;                     // stdin of squeezelite
+      uint64_t startAt;
+      cTimeMs readyCheck;           // next isPlayerConnected() after
+      cTimeMs reopen;               // next open of the LMS connection after
+      char line[sizeLine+TB];       // partial line of the output
+      int lineFill;
+      cCondWait wakeup;
+};
+
+//***************************************************************************
+#endif // __SQUEEZELITE_H
@@ -0,0 +1,329 @@
+/*
+ * statecache.c
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <set>
+
+#include "lib/common.h"
+
+#include "imgtools.h"
+#include "lmcmanager.h"
+#include "statecache.h"
+
+char* cStateCache::directory = 0;
+uint64_t cStateCache::savedVersion = 0;
+time_t cStateCache::savedAt = 0;
+
+static const char magicState[4] = { 'S', 'Q', 'S', 'C' };
+
+//***************************************************************************
+// Directory
+//***************************************************************************
+
+void cStateCache::setDirectory(const char* aDirectory)
+{
+   free(directory);
+   directory = aDirectory ? strdup(aDirectory) : 0;
+}
+
+std::string cStateCache::path()
+{
+   return std::string(directory) + "/state.bin";
+}
+
+//***************************************************************************
+// Terminate
+//  - the strings of a restored structure, whatever the file contained
+//***************************************************************************
+
+#define TERMINATE(s) (s)[sizeof(s)-1] = 0
+
+void cStateCache::terminate(PlayerState* state)
+{
+   TERMINATE(state->mode);
+   TERMINATE(state->version);
+   TERMINATE(state->plName);
+}
+
+void cStateCache::terminate(TrackInfo* track)
+{
+   TERMINATE(track->genre);
+   TERMINATE(track->album);
+   TERMINATE(track->artist);
+   TERMINATE(track->title);
+   TERMINATE(track->artworkTrackId);
+   TERMINATE(track->artworkurl);
+   TERMINATE(track->remoteTitle);
+   TERMINATE(track->contentType);
+   TERMINATE(track->lyrics);
+}
+
+#undef TERMINATE
+
+//***************************************************************************
+// Load
+//  - map the file and hand the snapshot over to the LMC manager, the
+//    covers go to the image cache if the OSD size is unchanged
+//***************************************************************************
+
+int cStateCache::load()
+{
+   struct stat st;
+   int fd;
+   const char* data;
+   const char* p;
+   const char* end;
+   const Header* header;
+
+   if (!directory)
+      return fail;
+
+   if ((fd = open(path().c_str(), O_RDONLY)) < 0)
+      return fail;                                 // nothing saved yet
+
+   if (fstat(fd, &st) != 0 || st.st_size < (off_t)(sizeof(Header) + sizeof(PlayerState)))
+   {
+      ::close(fd);
+      return fail;
+   }
+
+   data = (const char*)mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   ::close(fd);
+
+   if (data == MAP_FAILED)
+   {
+      tell(eloAlways, "Error: Mapping '%s' failed, %m", path().c_str());
+      return fail;
+   }
+
+   header = (const Header*)data;
+   p = data + sizeof(Header);
+   end = data + st.st_size;
+
+   if (memcmp(header->magic, magicState, sizeof(magicState)) != 0 || header->format != format
+       || header->sizeState != sizeof(PlayerState) || header->sizeTrack != sizeof(TrackInfo)
+       || header->trackCount < 0 || header->first < 0
+       || (size_t)(end - p) < sizeof(PlayerState)
+       || (size_t)header->trackCount > (size_t)(end - p - sizeof(PlayerState)) / sizeof(TrackInfo))
+   {
+      tell(eloAlways, "Ignoring state cache '%s', format or size doesn't match", path().c_str());
+      munmap((void*)data, st.st_size);
+      return fail;
+   }
+
+   // player state and playlist window
+
+   PlaylistSnapshot* s = new PlaylistSnapshot;
+
+   s->restored = yes;
+   s->first = header->first;
+   memcpy(&s->state, p, sizeof(PlayerState));
+   p += sizeof(PlayerState);
+
+   s->tracks.resize(header->trackCount);
+   memcpy(s->tracks.data(), p, header->trackCount * sizeof(TrackInfo));
+   p += header->trackCount * sizeof(TrackInfo);
+
+   // the file may be damaged, the strings are terminated anyway
+
+   terminate(&s->state);
+
+   for (auto it = s->tracks.begin(); it != s->tracks.end(); ++it)
+      terminate(&(*it));
+
+   LmcManager::restoreSnapshot(s);
+
+   // covers
+
+   int images = 0;
+
+   if (header->osdWidth != cOsd::OsdWidth() || header->osdHeight != cOsd::OsdHeight())
+   {
+      tell(eloDetail, "OSD size changed, ignoring the cached covers");
+   }
+   else
+   {
+      for (int i = 0; i < header->imageCount; i++)
+      {
+         const ImageHeader* ih = (const ImageHeader*)p;
+
+         if ((size_t)(end - p) < sizeof(ImageHeader))
+            break;
+
+         p += sizeof(ImageHeader);
+
+         // checked against the rest of the file before any rounding or
+         // multiplication, a damaged length must not wrap around
+
+         if (ih->keyLength > (size_t)(end - p) || ih->width <= 0 || ih->height <= 0
+             || ih->width > maxImageSize || ih->height > maxImageSize)
+            break;
+
+         size_t keySize = ((size_t)ih->keyLength + 3) & ~(size_t)3;
+         size_t pixels = (size_t)ih->width * ih->height;
+
+         if (keySize > (size_t)(end - p) || pixels * sizeof(tColor) > (size_t)(end - p) - keySize)
+            break;
+
+         std::string key(p, ih->keyLength);
+         p += keySize;
+
+         cImage image(cSize(ih->width, ih->height), (const tColor*)p);
+         cImageMagickWrapper::addCache(key, &image);
+         p += pixels * sizeof(tColor);
+         images++;
+      }
+   }
+
+   tell(eloAlways, "Restored player state with %d tracks and %d covers from '%s'",
+        header->trackCount, images, path().c_str());
+
+   munmap((void*)data, st.st_size);
+
+   return success;
+}
+
+//***************************************************************************
+// Save
+//  - only if the state changed since the last save, written to a
+//    temporary file first so a crash never leaves a half file
+//***************************************************************************
+
+int cStateCache::save(int force)
+{
+   LmcCom* lmc = LmcManager::get();
+   Header header;
+   FILE* fp;
+   SnapshotPtr s;
+
+   if (!directory || !lmc)
+      return done;
+
+   s = lmc->getSnapshot();
+
+   if (!s->version || s->restored)
+      return done;
+
+   // forced (on stop) also for an unchanged state, the covers may be new
+
+   if (!force && (s->version == savedVersion || savedAt + saveInterval > time(0)))
+      return done;
+
+   std::string tmp = path() + ".tmp";
+
+   if (!(fp = fopen(tmp.c_str(), "w")))
+   {
+      tell(eloAlways, "Error: Can't write state cache '%s', %m", tmp.c_str());
+      return fail;
+   }
+
+   int first = s->state.plIndex - windowBefore;
+   int last = s->state.plIndex + windowAfter;
+
+   if (first < s->first)
+      first = s->first;
+
+   if (last > s->getTrackCount())
+      last = s->getTrackCount();
+
+   if (last < first)
+      last = first;
+
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, magicState, sizeof(magicState));
+   header.format = format;
+   header.sizeState = sizeof(PlayerState);
+   header.sizeTrack = sizeof(TrackInfo);
+   header.osdWidth = cOsd::OsdWidth();
+   header.osdHeight = cOsd::OsdHeight();
+   header.first = first;
+   header.trackCount = last - first;
+
+   fwrite(&header, sizeof(header), 1, fp);
+   fwrite(&s->state, sizeof(PlayerState), 1, fp);
+
+   for (int i = first; i < last; i++)
+      fwrite(s->getTrack(i), sizeof(TrackInfo), 1, fp);
+
+   // covers of the window as scaled by the OSD, big one of the current track
+
+   std::set<std::string> keys;
+
+   keys.insert("cover_" + LmcCom::coverKey(s->getCurrentTrack()));
+
+   for (int i = first; i < last; i++)
+      keys.insert(LmcCom::coverKey(s->getTrack(i)));       // tracks of one album share it
+
+   {
+      cMutexLock lock(cImageMagickWrapper::getCacheMutex());
+
+      for (auto it = keys.begin(); it != keys.end(); ++it)
+         addImage(fp, *it, header.imageCount);
+   }
+
+   // header again, now with the image count
+
+   fseek(fp, 0, SEEK_SET);
+   fwrite(&header, sizeof(header), 1, fp);
+
+   int error = ferror(fp);
+
+   if (fclose(fp) != 0 || error)
+   {
+      tell(eloAlways, "Error: Writing state cache '%s' failed", tmp.c_str());
+      unlink(tmp.c_str());
+      return fail;
+   }
+
+   if (rename(tmp.c_str(), path().c_str()) != 0)
+   {
+      tell(eloAlways, "Error: Renaming '%s' failed, %m", tmp.c_str());
+      return fail;
+   }
+
+   savedVersion = s->version;
+   savedAt = time(0);
+
+   tell(eloDetail, "Saved player state with %d tracks and %d covers",
+        header.trackCount, header.imageCount);
+
+   return success;
+}
+
+//***************************************************************************
+// Add Image
+//***************************************************************************
+
+int cStateCache::addImage(FILE* fp, const std::string& key, int& count)
+{
+   static const char pad[4] = { 0, 0, 0, 0 };
+   const cImage* image = cImageMagickWrapper::fromCache(key);
+   ImageHeader ih;
+
+   if (!image)
+      return done;
+
+   ih.keyLength = key.length();
+   ih.width = image->Width();
+   ih.height = image->Height();
+
+   fwrite(&ih, sizeof(ih), 1, fp);
+   fwrite(key.c_str(), 1, key.length(), fp);
+   fwrite(pad, 1, ((key.length() + 3) & ~3) - key.length(), fp);
+   fwrite(image->Data(), sizeof(tColor), (size_t)ih.width * ih.height, fp);
+
+   count++;
+
+   return success;
+}
@@ -0,0 +1,76 @@
+/*
+ * statecache.h
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef __STATECACHE_H
+#define __STATECACHE_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "lmccom.h"
+
+//***************************************************************************
+// State Cache
+//  - the last player state, the visible window of the playlist and the
+//    scaled covers of it in one binary file of the plugin cache directory
+//  - written on stop and periodically by the housekeeping, loaded (mmap)
+//    with the plugin start so the first OSD is drawn before the LMS answers
+//***************************************************************************
+
+class cStateCache
+{
+   public:
+
+      enum Misc
+      {
+         format        = 1,          // increment on any layout change
+         windowBefore  = 5,          // tracks before the current one
+         windowAfter   = 20,         // and after it
+         saveInterval  = 300,        // [s]
+         maxImageSize  = 4096        // [pixel] width and height of a cover, larger is damaged
+      };
+
+      static void setDirectory(const char* aDirectory);
+
+      static int load();
+      static int save(int force = no);
+
+   protected:
+
+      struct Header
+      {
+         char magic[4];
+         uint32_t format;
+         uint32_t sizeState;         // the structures are stored as they are,
+         uint32_t sizeTrack;         //  their size guards against a changed layout
+         int32_t osdWidth;           // the covers are scaled for this OSD
+         int32_t osdHeight;
+         int32_t first;
+         int32_t trackCount;
+         int32_t imageCount;
+         int32_t reserved;
+      };
+
+      struct ImageHeader
+      {
+         uint32_t keyLength;         // the key is padded to 4 bytes
+         int32_t width;
+         int32_t height;
+      };
+
+      static int addImage(FILE* fp, const std::string& key, int& count);
+      static void terminate(PlayerState* state);
+      static void terminate(TrackInfo* track);
+      static std::string path();
+
+      static char* directory;
+      static uint64_t savedVersion;
+      static time_t savedAt;
+};
+
+//***************************************************************************
+#endif // __STATECACHE_H
@@ -24,10 +24,13 @@ int doShutdown = no;
 
 void showUsage(const char* name)
 {
-   printf("Usage: %s [-l <log-level>] [-h <host>] [-p port]\n", name);
+   printf("Usage: %s [-l <log-level>] [-h <host>] [-p port] [-H http-port] [-j] [-b <loops>]\n", name);
    printf("    -l <log-level>  set log level\n");
    printf("    -h <LMC-host>   \n");
    printf("    -p <LMC-port>   \n");
+   printf("    -H <LMC-http-port> (for JSON-RPC and covers)\n");
+   printf("    -j              use JSON-RPC transport\n");
+   printf("    -b <loops>      benchmark CLI against JSON-RPC (status and albums)\n");
 }
 
 //***************************************************************************
@@ -49,6 +52,50 @@ void showTags(char* buf)
    return ;
 }
 
+//***************************************************************************
+// Benchmark
+//***************************************************************************
+
+int benchmark(const char* mac, const char* host, unsigned short port,
+              unsigned short httpPort, int transport, int loops)
+{
+   LmcCom lmc(mac);
+   LmcCom::RangeList list;
+   uint64_t start;
+   uint64_t msUpdate = 0, msAlbums = 0;
+   int total = 0;
+   int count = 0;
+   const char* name = transport == LmcCom::ttJsonRpc ? "JSON-RPC" : "CLI";
+
+   lmc.setTransport(transport, httpPort);
+
+   if (lmc.open(host, port) != success)
+   {
+      tell(0, "Opening connection to LMC server at '%s:%d' failed", host, port);
+      return fail;
+   }
+
+   for (int i = 0; i < loops; i++)
+   {
+      start = cTimeMs::Now();
+      lmc.update();
+      msUpdate += cTimeMs::Now() - start;
+
+      start = cTimeMs::Now();
+      lmc.queryRange(LmcCom::rqtAlbums, 0, 100000, &list, total);
+      msAlbums += cTimeMs::Now() - start;
+      count = list.size();
+   }
+
+   tell(0, "%-8s: status with %d tracks %.2f ms, albums (%d of %d) %.2f ms (average of %d loops)",
+        name, lmc.getSnapshot()->getTrackCount(), msUpdate / (double)loops,
+        count, total, msAlbums / (double)loops, loops);
+
+   lmc.close();
+
+   return success;
+}
+
 //***************************************************************************
 // Main
 //***************************************************************************
@@ -59,6 +106,9 @@ int main(int argc, char** argv)
    const char* command = 0;
    const char* parameter = 0;
    unsigned short lmcPort = 9090;
+   unsigned short lmcHttpPort = 9000;
+   int transport = LmcCom::ttCli;
+   int loops = 0;
    char* mac = getMac();
    MemoryStruct cover;
 
@@ -67,8 +117,9 @@ int main(int argc, char** argv)
 
    LmcCom::RangeList list;
    LmcCom* lmc = new LmcCom(mac);
-   LmcCom::TrackInfo* track = 0;
-   LmcCom::PlayerState* player;
+   const TrackInfo* track = 0;
+   const PlayerState* player;
+   SnapshotPtr snapshot;
 
    // Usage ..
 
@@ -90,6 +141,9 @@ int main(int argc, char** argv)
          case 'l': if (argv[i+1]) loglevel = atoi(argv[++i]); break;
          case 'h': if (argv[i+1]) lmcHost = argv[++i];        break;
          case 'p': if (argv[i+1]) lmcPort = atoi(argv[++i]);  break;
+         case 'H': if (argv[i+1]) lmcHttpPort = atoi(argv[++i]); break;
+         case 'j': transport = LmcCom::ttJsonRpc;              break;
+         case 'b': if (argv[i+1]) loops = atoi(argv[++i]);    break;
          case 'c': if (argv[i+1]) command = argv[++i];        break;
          case 'P': if (argv[i+1]) parameter = argv[++i];      break;
          case 'e':
@@ -108,8 +162,17 @@ int main(int argc, char** argv)
 //    ::signal(SIGINT, downF);
 //    ::signal(SIGTERM, downF);
 
+   if (loops > 0)
+   {
+      benchmark(mac, lmcHost, lmcPort, lmcHttpPort, LmcCom::ttCli, loops);
+      benchmark(mac, lmcHost, lmcPort, lmcHttpPort, LmcCom::ttJsonRpc, loops);
+      goto EXIT;
+   }
+
    // open LMC connection
 
+   lmc->setTransport(transport, lmcHttpPort);
+
    if (lmc->open(lmcHost, lmcPort) != success)
    {
       tell(0, "Opening connection to LMC server at '%s:%d' failed", lmcHost, lmcPort);
@@ -162,7 +225,8 @@ int main(int argc, char** argv)
 
    tell(0, "--------------------------");
    lmc->update();
-   player = lmc->getPlayerState();
+   snapshot = lmc->getSnapshot();
+   player = &snapshot->state;
 
    lmc->repeat();
    lmc->repeat();
@@ -182,7 +246,7 @@ int main(int argc, char** argv)
    tell(0, "Player: mode %s; volume %d; muted %s, currend track index %d",
         player->mode, player->volume, player->muted ? "yes" : "no", player->plIndex);
 
-   track = lmc->getCurrentTrack();
+   track = snapshot->getCurrentTrack();
 
    if (track)
    {
@@ -245,9 +309,9 @@ int main(int argc, char** argv)
       // lmc->updateTrackList();
       tell(0, "Playlist: '%s'", player->plName);
 
-      for (int i = 0; i < lmc->getTrackCount(); i++)
+      for (int i = 0; i < snapshot->getTrackCount(); i++)
          tell(0, "  (%d) '%s' - '%s'", i,
-              lmc->getTrack(i)->artist, lmc->getTrack(i)->title);
+              snapshot->getTrack(i)->artist, snapshot->getTrack(i)->title);
    }
 
   EXIT: